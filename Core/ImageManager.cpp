@@ -82,6 +82,28 @@ sf::Image& ImageManager::getImage( const std::string& filename )
 	}
 }
 
+std::string ImageManager::findImageFile( const std::string& filename ) const
+{
+	FILE *file = fopen(filename.c_str(), "rb");
+	if( file != nullptr )
+	{
+		fclose(file);
+		return filename;
+	}
+
+	for each(const auto& dir in resourceDirs)
+	{
+		file = fopen((dir + filename).c_str(), "rb");
+		if( file != nullptr )
+		{
+			fclose(file);
+			return dir + filename;
+		}
+	}
+
+	return "";
+}
+
 void ImageManager::deleteImage( const Image& image )
 {
 	StringImageMapConstIter it  = images.begin();
@@ -33,6 +33,10 @@ public:
 	// specified in resourceDirs.
 	sf::Image& getImage(const std::string& filename);
 
+	// Path getImage() would load the specified image from,
+	// searched in the same order, or empty if it doesn't exist
+	std::string findImageFile(const std::string& filename) const;
+
 	// Delete the specified image, by value
 	void deleteImage(const sf::Image& image);
 	// Delete the specified image, by filename
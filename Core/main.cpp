@@ -4,15 +4,33 @@
 /* Program entry point
 /************************************************************************/
 #include "MainWindow.h"
+#include "../Scene/FluidBenchmark.h"
+#include "../Scene/TerrainStreamerCheck.h"
 
 #include <exception>
 #include <iostream>
 #include <conio.h>
+#include <cstring>
 
 using namespace std;
 
-int main()
+int main(int argc, char *argv[])
 {
+	// Headless modes for checking the fluid solver and terrain
+	// streaming without a window
+	for(int i = 1; i < argc; ++i)
+	{
+		if( strcmp(argv[i], "--bench-fluid") == 0 )
+		{
+			fluidbench::run(cout);
+			return EXIT_SUCCESS;
+		}
+		if( strcmp(argv[i], "--verify-fluid") == 0 )
+			return fluidbench::verify(cout) ? EXIT_SUCCESS : EXIT_FAILURE;
+		if( strcmp(argv[i], "--verify-streamer") == 0 )
+			return streamercheck::verify(cout) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
 	try {
 		MainWindow app;
 	} catch(std::runtime_error& e) {
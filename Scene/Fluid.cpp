@@ -20,6 +20,10 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
 using namespace glm;
 
 
@@ -47,9 +51,7 @@ Fluid::Fluid( long n, long m, float d
 	buffer[1] = new vec3[count];
 	renderBuffer = 0;
 
-	long numTris = 2 * (width - 1) * (height - 1);
-	numIndices   = 3 * numTris;
-	indices = new unsigned int[numIndices];
+	indices = &GetGridIndices(width, height, GridIndices::main_diagonal);
 
 	normal  = new vec3[count];
 	tangent = new vec3[count];
@@ -78,30 +80,12 @@ Fluid::Fluid( long n, long m, float d
 		}
 	}
 
-	// Initialize index buffer
-	a = 0;
-	for(long j = 0; j < (m - 1); ++j)
-	for(long i = 0; i < (n - 1); ++i)
-	{
-		const long a0 = width *  j    +  i;
-		const long a1 = width *  j    + (i+1);
-		const long a2 = width * (j+1) + (i+1);
-		const long a3 = width * (j+1) +  i;
-
-		// First triangle
-		indices[a++] = a0;
-		indices[a++] = a3;
-		indices[a++] = a2;
-
-		// Second triangle
-		indices[a++] = a0;
-		indices[a++] = a2;
-		indices[a++] = a1;
-	}
-
 	evalTimer.Reset();
 	t_step = t;
 
+	quietSteps = 0;
+	sleeping   = false;
+
 	blend = true;
 	light = true;
 
@@ -113,7 +97,6 @@ Fluid::~Fluid()
 {
 	delete[] tangent;
 	delete[] normal;
-	delete[] indices;
 	delete[] buffer[1];
 	delete[] buffer[0];
 
@@ -132,6 +115,11 @@ void Fluid::render(const Camera& camera)
 //	subRender(camera);
 }
 
+// Amplitude below which a surface counts as settled
+static const float sleepAmplitude = 1e-4f;
+// Number of consecutive settled steps before a surface sleeps
+static const unsigned int sleepSteps = 60;
+
 void Fluid::evaluate()
 {
 	if( evalTimer.GetElapsedTime() < t_step )
@@ -139,7 +127,16 @@ void Fluid::evaluate()
 	else
 		evalTimer.Reset();
 
+	step();
+}
+
+void Fluid::step()
+{
+	if( sleeping )
+		return;
+
 	// Apply equation 15.25
+	float amplitude = 0.f;
 	for(long j = 1; j < height - 1; ++j)
 	{
 		const vec3 *crnt = buffer[renderBuffer] + j * width;
@@ -153,9 +150,19 @@ void Fluid::evaluate()
 							+ crnt[i - 1].z
 						    + crnt[i + width].z
 							+ crnt[i - width].z);
+
+			amplitude = std::max(amplitude, std::abs(prev[i].z));
 		}
 	}
 
+	if( amplitude < sleepAmplitude )
+	{
+		if( ++quietSteps >= sleepSteps )
+			sleeping = true;
+	}
+	else
+		quietSteps = 0;
+
 	// The edge vertices can get out of whack after
 	// some disturbances, this forces them to stay put,
 	// but it is pretty hacky, and could probably be
@@ -202,15 +209,167 @@ void Fluid::displace()
 	const int j = static_cast<int>(glm::linearRand(0.f, (float)height));
 	vec3& v = *(buffer[1 - renderBuffer] + j * width + i);
 	v.z -= d * scale;
+	wake();
 }
 
-void Fluid::displace(float x, float z, float scale = 1.f, float velocity = 1.f)
+void Fluid::displace(float x, float z, float scale /* = 1.f */, float velocity /* = 1.f */)
 {
-	const float d = velocity;
-	const int i = static_cast<int>(x);
-	const int j = static_cast<int>(z);
-	vec3& v = *(buffer[1 - renderBuffer] + j * width + i);
-	v.z -= d * scale;
+	const FluidSplat splat(x, z, velocity * scale);
+	displace(&splat, 1);
+}
+
+void Fluid::displace( const FluidSplats& splats )
+{
+	if( !splats.empty() )
+		displace(&splats[0], splats.size());
+}
+
+void Fluid::displace( const FluidSplat *splats, const unsigned int count )
+{
+	assert(splats != nullptr || count == 0);
+	if( count == 0 )
+		return;
+	wake();
+
+	vec3 *prev = buffer[1 - renderBuffer];
+
+	// Clamp so that the 2x2 vertex footprint stays on the grid
+	const float maxX = static_cast<float>(width  - 1);
+	const float maxZ = static_cast<float>(height - 1);
+	const long  maxI = width  - 2;
+	const long  maxJ = height - 2;
+
+	for(unsigned int n = 0; n < count; ++n)
+	{
+		const FluidSplat& splat = splats[n];
+
+		const float x = clamp(splat.x, 0.f, maxX);
+		const float z = clamp(splat.z, 0.f, maxZ);
+
+		long i = static_cast<long>(x);
+		long j = static_cast<long>(z);
+		if( i > maxI ) i = maxI;
+		if( j > maxJ ) j = maxJ;
+
+		const float fx = x - i;
+		const float fz = z - j;
+
+		vec3 *row0 = prev + j * width + i;
+		vec3 *row1 = row0 + width;
+
+		row0[0].z -= splat.impulse * (1.f - fx) * (1.f - fz);
+		row0[1].z -= splat.impulse * fx * (1.f - fz);
+		row1[0].z -= splat.impulse * (1.f - fx) * fz;
+		row1[1].z -= splat.impulse * fx * fz;
+	}
+}
+
+void Fluid::displaceRadial( float x, float z, float radius, float impulse )
+{
+	if( radius <= 1.f )
+	{
+		displace(x, z, 1.f, impulse);
+		return;
+	}
+
+	const long i0 = std::max(0L, static_cast<long>(std::floor(x - radius)));
+	const long j0 = std::max(0L, static_cast<long>(std::floor(z - radius)));
+	const long i1 = std::min(width  - 1, static_cast<long>(std::ceil(x + radius)));
+	const long j1 = std::min(height - 1, static_cast<long>(std::ceil(z + radius)));
+	if( i0 > i1 || j0 > j1 )
+		return;
+
+	// Smooth (1 - r^2/R^2)^2 kernel, weights are normalized 
+	// over the vertices that actually land on the grid
+	const float invR2 = 1.f / (radius * radius);
+
+	float total = 0.f;
+	for(long j = j0; j <= j1; ++j)
+	for(long i = i0; i <= i1; ++i)
+	{
+		const float dx = i - x;
+		const float dz = j - z;
+		const float t  = 1.f - (dx * dx + dz * dz) * invR2;
+		if( t > 0.f )
+			total += t * t;
+	}
+	if( total <= 0.f )
+		return;
+
+	const float k = impulse / total;
+	wake();
+
+	vec3 *prev = buffer[1 - renderBuffer];
+	for(long j = j0; j <= j1; ++j)
+	{
+		vec3 *row = prev + j * width;
+		const float dz = j - z;
+
+		for(long i = i0; i <= i1; ++i)
+		{
+			const float dx = i - x;
+			const float t  = 1.f - (dx * dx + dz * dz) * invR2;
+			if( t > 0.f )
+				row[i].z -= k * t * t;
+		}
+	}
+}
+
+void Fluid::sampleSurface( const vec2 *points
+						 , const unsigned int count
+						 , float *heights
+						 , vec3 *normals /* = nullptr */ ) const
+{
+	assert(points != nullptr || count == 0);
+	assert(heights != nullptr || count == 0);
+
+	// The surface is drawn rotated so that local +z points down world -y,
+	// world height is pos.y - z and grid axes line up with world x and z
+	const vec3 *crnt   = buffer[renderBuffer];
+	const float invDist = 1.f / dist;
+	const float maxX   = static_cast<float>(width  - 1);
+	const float maxZ   = static_cast<float>(height - 1);
+	const long  maxI   = width  - 2;
+	const long  maxJ   = height - 2;
+
+	for(unsigned int n = 0; n < count; ++n)
+	{
+		const float gx = (points[n].x - pos.x) * invDist;
+		const float gz = (points[n].y - pos.z) * invDist;
+
+		if( gx < 0.f || gz < 0.f || gx > maxX || gz > maxZ )
+		{
+			heights[n] = pos.y;
+			if( normals != nullptr )
+				normals[n] = vec3(0.f, 1.f, 0.f);
+			continue;
+		}
+
+		long i = static_cast<long>(gx);
+		long j = static_cast<long>(gz);
+		if( i > maxI ) i = maxI;
+		if( j > maxJ ) j = maxJ;
+
+		const float fx = gx - i;
+		const float fz = gz - j;
+
+		const vec3 *row0 = crnt + j * width + i;
+		const vec3 *row1 = row0 + width;
+		const float h00 = row0[0].z, h10 = row0[1].z;
+		const float h01 = row1[0].z, h11 = row1[1].z;
+
+		const float h0 = h00 + fx * (h10 - h00);
+		const float h1 = h01 + fx * (h11 - h01);
+		heights[n] = pos.y - (h0 + fz * (h1 - h0));
+
+		if( normals != nullptr )
+		{
+			// Slopes of the bilinear patch, in world units
+			const float dhdx = ((h10 - h00) + fz * ((h11 - h01) - (h10 - h00))) * invDist;
+			const float dhdz = (h1 - h0) * invDist;
+			normals[n] = normalize(vec3(dhdx, 1.f, dhdz));
+		}
+	}
 }
 
 float* Fluid::getVertexBufferPtr()
@@ -385,10 +544,7 @@ void Fluid::subRender( const Camera& camera )
 
 //		glColor4f(0.0f, 0.8f, 1.0f, 0.5f);
 //		glColor4f(0.1f, 1.f, 1.f, 0.5f);
-		glDrawElements(GL_TRIANGLES
-					 , numIndices
-					 , GL_UNSIGNED_INT
-					 , indices);
+		indices->draw(GL_TRIANGLES);
 	glPopMatrix();
 
 	glDisableClientState(GL_VERTEX_ARRAY);
@@ -7,14 +7,44 @@
 /* Based on example from chapter 15 in:
 /* "Mathematics for 3D Game Programming and Computer Graphics 3rd Ed."
 /************************************************************************/
+#include "../Utility/GridIndices.h"
+
 #include <SFML/System/Clock.hpp>
 
 #include <glm/glm.hpp>
 
+#include <vector>
+
 class Skybox;
 class Camera;
 
 
+/**
+* A single displacement sample in fluid grid space
+*     x,z - grid coordinates, in units of vertices
+* impulse - amount to displace the surface (scale * velocity)
+**/
+class FluidSplat
+{
+public:
+	float x;
+	float z;
+	float impulse;
+
+	FluidSplat( const float x = 0.f
+			  , const float z = 0.f
+			  , const float impulse = 0.f )
+		: x(x)
+		, z(z)
+		, impulse(impulse)
+	{ }
+};
+
+typedef std::vector<FluidSplat>    FluidSplats;
+typedef FluidSplats::iterator       FluidSplatsIter;
+typedef FluidSplats::const_iterator FluidSplatsConstIter;
+
+
 class Fluid
 {
 private:
@@ -25,8 +55,8 @@ private:
 	glm::vec3 *buffer[2];
 	long renderBuffer;
 
-	long numIndices;
-	unsigned int *indices;
+	// Shared with every other fluid of the same dimensions
+	const GridIndices *indices;
 
 	glm::vec3 *normal;
 	glm::vec3 *tangent;
@@ -35,6 +65,11 @@ private:
 
 	sf::Clock evalTimer;
 
+	// Sleep tracking, a surface that has settled stops being stepped
+	// until it is displaced again
+	unsigned int quietSteps;
+	bool sleeping;
+
 	Skybox *skybox;
 	
 	unsigned int skyboxEnvTextureDay;
@@ -68,17 +103,50 @@ public:
 
 	void render(const Camera& camera);
 
+	// Advance the simulation if at least one time step has elapsed
 	void evaluate();
+	// Advance the simulation by exactly one time step
+	void step();
+
 	void displace();
-	void displace(float x, float z, float scale, float velocity);
+	void displace(float x, float z, float scale = 1.f, float velocity = 1.f);
+
+	// Splat a batch of displacements into the surface in one pass,
+	// each spread bilinearly over its 4 nearest vertices.
+	// Samples that fall off the grid are clamped to its edges.
+	void displace(const FluidSplat *splats, const unsigned int count);
+	void displace(const FluidSplats& splats);
+
+	// Sample the surface at a batch of world space XZ points, giving 
+	// the world height and unit normal interpolated from the current 
+	// render buffer. Points off the surface get its rest height and 
+	// an up normal. Pass a null normals pointer to skip normals.
+	void sampleSurface( const glm::vec2 *points
+					  , const unsigned int count
+					  , float *heights
+					  , glm::vec3 *normals = nullptr ) const;
+
+	// Displace all vertices within radius (in grid units) of x,z 
+	// using a smooth falloff kernel, for large impacts.
+	// The impulse is normalized over the kernel so the total 
+	// displacement matches a single splat of the same impulse.
+	void displaceRadial(float x, float z, float radius, float impulse);
 
 	const long getWidth() const;
 	const long getHeight() const;
+	const long getNumCells() const;
 
 	float getDist() const;
+	float getTimeStep() const;
+	bool isSleeping() const;
+	void wake();
 	void setSkybox(Skybox *box);
 };
 
 inline float Fluid::getDist() const { return dist; } 
+inline float Fluid::getTimeStep() const { return t_step; }
+inline bool Fluid::isSleeping() const { return sleeping; }
+inline void Fluid::wake() { sleeping = false; quietSteps = 0; }
+inline const long Fluid::getNumCells() const { return width * height; }
 inline const long Fluid::getHeight() const { return height;}
 inline const long Fluid::getWidth() const { return width;}
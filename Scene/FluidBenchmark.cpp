@@ -0,0 +1,302 @@
+/************************************************************************/
+/* FluidBenchmark
+/* --------------
+/* Headless timing and golden-state checks for the Fluid solver,
+/* run from the command line without opening a window
+/************************************************************************/
+#include "FluidBenchmark.h"
+#include "Fluid.h"
+#include "FluidManager.h"
+#include "../Utility/Parallel.h"
+
+#include <SFML/System/Clock.hpp>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cmath>
+
+using namespace glm;
+
+
+namespace
+{
+	// Small deterministic generator so runs are repeatable anywhere
+	class Lcg
+	{
+	private:
+		unsigned int state;
+
+	public:
+		Lcg(const unsigned int seed) : state(seed) { }
+
+		// Uniform float in [lo,hi)
+		float next(const float lo, const float hi)
+		{
+			state = state * 1664525u + 1013904223u;
+			return lo + (hi - lo) * ((state >> 8) * (1.f / 16777216.f));
+		}
+	};
+
+	enum Pattern { center_drop, rain, line };
+
+	const char* patternName(const Pattern pattern)
+	{
+		switch(pattern)
+		{
+		case center_drop: return "drop";
+		case rain:        return "rain";
+		case line:        return "line";
+		default:          return "?";
+		}
+	}
+
+	// Disturb a surface for the given pattern and step number
+	void disturb(Fluid& fluid, const Pattern pattern, const unsigned int step, Lcg& rng)
+	{
+		const float w = static_cast<float>(fluid.getWidth()  - 1);
+		const float h = static_cast<float>(fluid.getHeight() - 1);
+
+		switch(pattern)
+		{
+		case center_drop:
+			if( step == 0 )
+				fluid.displaceRadial(0.5f * w, 0.5f * h, 4.f, 2.f);
+			break;
+		case rain:
+			{
+				FluidSplats splats;
+				for(unsigned int i = 0; i < 8; ++i)
+					splats.push_back(FluidSplat(rng.next(0.f, w), rng.next(0.f, h), rng.next(0.01f, 0.2f)));
+				fluid.displace(splats);
+			}
+			break;
+		case line:
+			if( step % 50 == 0 )
+			{
+				FluidSplats splats;
+				for(float x = 1.f; x < w; x += 1.f)
+					splats.push_back(FluidSplat(x, 0.25f * h, 0.5f));
+				fluid.displace(splats);
+			}
+			break;
+		}
+	}
+
+	// Parameters shared by the benchmark and golden cases
+	struct Case
+	{
+		long width;
+		long height;
+		float dist;
+		float c;
+		float mu;
+		Pattern pattern;
+	};
+
+	Fluid* makeFluid(const Case& test)
+	{
+		return new Fluid(test.width, test.height, test.dist, 0.03f, test.c, test.mu);
+	}
+
+	// Summary of a surface's current heights
+	struct Checksum
+	{
+		double sum;
+		double sumAbs;
+		double sumSq;
+	};
+
+	Checksum checksum(const Fluid& fluid)
+	{
+		const long w = fluid.getWidth();
+		const long h = fluid.getHeight();
+		const float dist = fluid.getDist();
+
+		// Sample at the vertices through the public query
+		std::vector<vec2>  points;
+		std::vector<float> heights(w * h);
+		points.reserve(w * h);
+		for(long j = 0; j < h; ++j)
+		for(long i = 0; i < w; ++i)
+			points.push_back(vec2(fluid.pos.x + i * dist, fluid.pos.z + j * dist));
+		fluid.sampleSurface(&points[0], points.size(), &heights[0]);
+
+		Checksum result = { 0.0, 0.0, 0.0 };
+		for(unsigned int i = 0; i < heights.size(); ++i)
+		{
+			const double z = heights[i] - fluid.pos.y;
+			result.sum    += z;
+			result.sumAbs += std::abs(z);
+			result.sumSq  += z * z;
+		}
+		return result;
+	}
+
+	// FluidManager steps fewer awake cells than this on one thread
+	const long minParallelCells = 16384;
+
+	bool close(const double value, const double expected)
+	{
+		// Loose enough to absorb x87 vs SSE rounding, tight enough
+		// to catch a solver that changes the physics
+		return std::abs(value - expected) <= 1e-4 + 1e-3 * std::abs(expected);
+	}
+}
+
+
+void fluidbench::run( std::ostream& out )
+{
+	static const Case cases[] = {
+		{  41,  81, 0.25f,  4.f, 0.4f, rain        },  // fountain
+		{ 128, 146, 2.2f,  10.f, 0.1f, rain        },  // lake
+		{ 256, 256, 1.f,    8.f, 0.1f, center_drop },
+		{ 256, 256, 1.f,    8.f, 0.1f, line        },
+		{ 512, 512, 1.f,    8.f, 0.1f, rain        }
+	};
+	static const unsigned int numCases = sizeof(cases) / sizeof(cases[0]);
+	static const unsigned int steps    = 200;
+	static const unsigned int copies   = 16;  // surfaces per case
+
+	out << "Fluid solver benchmark (" << steps << " steps, " << copies 
+		<< " surfaces per case, " << parallel::numWorkers() << " workers)" << std::endl;
+	out << std::setw(10) << "grid"    << std::setw(8) << "pattern" 
+		<< std::setw(10) << "variant" << std::setw(16) << "cells/s" 
+		<< std::setw(10) << "ns/cell" << std::endl;
+
+	for(unsigned int c = 0; c < numCases; ++c)
+	{
+		const Case& test = cases[c];
+
+		for(unsigned int variant = 0; variant < 2; ++variant)
+		{
+			// Serial steps each surface in turn on this thread,
+			// manager spreads them over workers like the scene does
+			FluidManager manager(0.03f);
+			Fluids fluids;
+			for(unsigned int i = 0; i < copies; ++i)
+			{
+				Fluid *fluid = makeFluid(test);
+				fluids.push_back(fluid);
+				manager.add(fluid);
+			}
+
+			Lcg rng(1234u + c);
+			sf::Clock clock;
+			clock.Reset();
+			for(unsigned int s = 0; s < steps; ++s)
+			{
+				for(unsigned int i = 0; i < fluids.size(); ++i)
+					disturb(*fluids[i], test.pattern, s, rng);
+
+				if( variant == 0 )
+				{
+					for(unsigned int i = 0; i < fluids.size(); ++i)
+						fluids[i]->step();
+				}
+				else
+					manager.stepAll();
+			}
+			const double seconds = clock.GetElapsedTime();
+
+			const double cells = static_cast<double>(test.width * test.height) * steps * copies;
+			std::stringstream grid;
+			grid << test.width << "x" << test.height;
+
+			out << std::setw(10) << grid.str() 
+				<< std::setw(8)  << patternName(test.pattern)
+				<< std::setw(10) << (variant == 0 ? "serial" : "manager")
+				<< std::setw(16) << std::fixed << std::setprecision(0) << (seconds > 0.0 ? cells / seconds : 0.0)
+				<< std::setw(10) << std::setprecision(3) << (seconds * 1e9 / cells)
+				<< std::endl;
+		}
+	}
+}
+
+bool fluidbench::verify( std::ostream& out )
+{
+	struct Golden
+	{
+		Case     test;
+		Checksum expected;
+	};
+
+	// Regenerate these only for intentional changes to the physics
+	static const Golden goldens[] = {
+		{ {  64,  64, 1.f,   8.f, 0.1f, center_drop }, {     87.58885001,   117.8064293,     8.932932821 } },
+		{ {  41,  81, 0.25f, 4.f, 0.4f, rain        }, {   -252.1464104,    274.6664332,    38.08276979 } },
+		{ { 128, 146, 2.2f, 10.f, 0.1f, line        }, { -37075.88519,  37152.12047,  204199.8895 } }
+	};
+	static const unsigned int numGoldens = sizeof(goldens) / sizeof(goldens[0]);
+	static const unsigned int steps      = 300;
+
+	bool passed = true;
+	for(unsigned int g = 0; g < numGoldens; ++g)
+	{
+		const Golden& golden = goldens[g];
+
+		// Step copies serially and the same copies through the manager,
+		// enough of them that it spreads them over its workers. Each pair
+		// must agree exactly and the first must match the stored state.
+		const long cells = golden.test.width * golden.test.height;
+		const unsigned int copies = std::max<unsigned int>(parallel::numWorkers()
+														 , static_cast<unsigned int>(minParallelCells / cells + 1));
+		Fluids serial;
+		FluidManager manager(0.03f);
+		std::vector<Lcg> rngSerial, rngManaged;
+		for(unsigned int k = 0; k < copies; ++k)
+		{
+			serial.push_back(makeFluid(golden.test));
+			manager.add(makeFluid(golden.test));
+			rngSerial.push_back(Lcg(42u + g + 1000u * k));
+			rngManaged.push_back(Lcg(42u + g + 1000u * k));
+		}
+		const Fluids& managed = manager.getFluids();
+
+		for(unsigned int s = 0; s < steps; ++s)
+		{
+			for(unsigned int k = 0; k < copies; ++k)
+			{
+				disturb(*serial[k],  golden.test.pattern, s, rngSerial[k]);
+				disturb(*managed[k], golden.test.pattern, s, rngManaged[k]);
+				serial[k]->step();
+			}
+			manager.stepAll();
+		}
+
+		bool same = true;
+		for(unsigned int k = 0; k < copies; ++k)
+		{
+			const Checksum a = checksum(*serial[k]);
+			const Checksum b = checksum(*managed[k]);
+			same = same && (a.sum == b.sum && a.sumAbs == b.sumAbs && a.sumSq == b.sumSq);
+		}
+
+		const Checksum a = checksum(*serial[0]);
+		for each(auto fluid in serial)
+			delete fluid;
+
+		const bool match = close(a.sum,    golden.expected.sum)
+						&& close(a.sumAbs, golden.expected.sumAbs)
+						&& close(a.sumSq,  golden.expected.sumSq);
+
+		out << std::setprecision(10)
+			<< golden.test.width << "x" << golden.test.height << " " 
+			<< patternName(golden.test.pattern) << ": "
+			<< "sum " << a.sum << ", abs " << a.sumAbs << ", sq " << a.sumSq
+			<< (match ? "  ok" : "  MISMATCH")
+			<< (same  ? ""     : "  (serial and manager disagree)")
+			<< "  [" << copies << " surfaces]"
+			<< std::endl;
+
+		passed = passed && match && same;
+	}
+
+	out << (passed ? "Fluid golden state: passed" : "Fluid golden state: FAILED") << std::endl;
+	return passed;
+}
@@ -0,0 +1,20 @@
+#pragma once
+/************************************************************************/
+/* FluidBenchmark
+/* --------------
+/* Headless timing and golden-state checks for the Fluid solver,
+/* run from the command line without opening a window
+/************************************************************************/
+#include <ostream>
+
+
+namespace fluidbench
+{
+	// Time the solver over several grid sizes, displacement patterns
+	// and solver variants, reporting cells/second and ns/cell
+	void run(std::ostream& out);
+
+	// Step seeded surfaces a fixed number of times and compare their
+	// state against stored checksums, false if any case has drifted
+	bool verify(std::ostream& out);
+};
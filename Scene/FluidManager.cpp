@@ -0,0 +1,141 @@
+/************************************************************************/
+/* FluidManager
+/* ------------
+/* Owns every Fluid surface in a scene and steps them together 
+/* on a shared fixed time step, spread across worker threads
+/************************************************************************/
+#include "FluidManager.h"
+#include "Fluid.h"
+#include "../Utility/Parallel.h"
+#include "../Utility/Logger.h"
+
+#include <SFML/System/Clock.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <sstream>
+#include <cmath>
+
+// Most steps to take in one update, so a long frame can't spiral
+static const unsigned int maxStepsPerUpdate = 4;
+// Below this many awake cells it isn't worth waking worker threads
+static const long minParallelCells = 16384;
+
+
+FluidManager::FluidManager(const float timeStep)
+	: fluids()
+	, timer()
+	, timeStep(timeStep)
+	, accumulator(0.f)
+	, batches()
+{
+	timer.Reset();
+}
+
+FluidManager::~FluidManager()
+{
+	clean();
+}
+
+void FluidManager::add( Fluid* fluid )
+{
+	assert(fluid != nullptr);
+
+	if( std::abs(fluid->getTimeStep() - timeStep) > 1e-6f )
+	{
+		std::stringstream ss;
+		ss << "Warning: fluid time step " << fluid->getTimeStep() 
+		   << " differs from the shared step " << timeStep;
+		Log(ss);
+	}
+
+	fluids.push_back(fluid);
+}
+
+void FluidManager::remove( Fluid* fluid )
+{
+	assert(fluid != nullptr);
+
+	FluidsIter it = std::find(fluids.begin(), fluids.end(), fluid);
+	if( it != fluids.end() )
+	{
+		fluids.erase(it);
+		delete fluid;
+	}
+}
+
+void FluidManager::update()
+{
+	accumulator += timer.GetElapsedTime();
+	timer.Reset();
+
+	unsigned int steps = 0;
+	while( accumulator >= timeStep && steps < maxStepsPerUpdate )
+	{
+		stepAll();
+		accumulator -= timeStep;
+		++steps;
+	}
+
+	// Drop whatever time we couldn't keep up with
+	if( steps == maxStepsPerUpdate )
+		accumulator = 0.f;
+}
+
+void FluidManager::clean()
+{
+	for each(auto fluid in fluids)
+		delete fluid;
+	fluids.clear();
+	batches.clear();
+}
+
+void FluidManager::stepAll()
+{
+	buildBatches();
+	if( batches.empty() )
+		return;
+
+	parallel::forRange(0, batches.size(), [&](unsigned int first, unsigned int last)
+	{
+		for(unsigned int b = first; b < last; ++b)
+		for(unsigned int i = 0; i < batches[b].size(); ++i)
+			batches[b][i]->step();
+	});
+}
+
+void FluidManager::buildBatches()
+{
+	batches.clear();
+
+	Fluids awake;
+	long awakeCells = 0;
+	for each(auto fluid in fluids)
+	{
+		if( !fluid->isSleeping() )
+		{
+			awake.push_back(fluid);
+			awakeCells += fluid->getNumCells();
+		}
+	}
+	if( awake.empty() )
+		return;
+
+	const unsigned int numBatches = (awakeCells < minParallelCells)
+		? 1 : std::min<unsigned int>(parallel::numWorkers(), awake.size());
+
+	// Largest first, each to the least loaded batch
+	std::sort(awake.begin(), awake.end(), [](const Fluid* a, const Fluid* b) -> bool
+	{
+		return a->getNumCells() > b->getNumCells();
+	});
+
+	batches.resize(numBatches);
+	std::vector<long> load(numBatches, 0);
+	for each(auto fluid in awake)
+	{
+		const unsigned int b = std::min_element(load.begin(), load.end()) - load.begin();
+		batches[b].push_back(fluid);
+		load[b] += fluid->getNumCells();
+	}
+}
@@ -0,0 +1,54 @@
+#pragma once
+/************************************************************************/
+/* FluidManager
+/* ------------
+/* Owns every Fluid surface in a scene and steps them together 
+/* on a shared fixed time step, spread across worker threads
+/************************************************************************/
+#include <SFML/System/Clock.hpp>
+
+#include <vector>
+
+class Fluid;
+
+typedef std::vector<Fluid*>    Fluids;
+typedef Fluids::iterator       FluidsIter;
+typedef Fluids::const_iterator FluidsConstIter;
+
+
+class FluidManager
+{
+private:
+	Fluids    fluids;
+	sf::Clock timer;
+	float     timeStep;     // shared fixed step, in seconds
+	float     accumulator;  // unsimulated time carried between updates
+
+	// Per-worker batches of awake fluids, rebuilt each step
+	std::vector<Fluids> batches;
+
+	// Assign awake fluids to batches balanced by cell count
+	void buildBatches();
+
+public:
+	FluidManager(const float timeStep = 0.03f);
+	~FluidManager();
+
+	// Add a fluid surface, the manager takes ownership of it
+	void add(Fluid* fluid);
+	// Remove and delete the specified fluid surface
+	void remove(Fluid* fluid);
+
+	// Advance all fluid surfaces by as many fixed steps as have elapsed
+	void update();
+	// Step every awake fluid surface exactly once, in parallel
+	void stepAll();
+	// Delete all fluid surfaces
+	void clean();
+
+	float getTimeStep() const;
+	const Fluids& getFluids() const;
+};
+
+inline float FluidManager::getTimeStep() const { return timeStep; }
+inline const Fluids& FluidManager::getFluids() const { return fluids; }
@@ -3,37 +3,85 @@
 /* ---------
 /* A basic height map mesh 
 /************************************************************************/
+#include "../Lib/glee/GLee.h"
+
 #include "HeightMap.h"
+#include "Camera.h"
+#include "TerrainGen.h"
 #include "../Utility/Mesh.h"
 #include "../Core/ImageManager.h"
+#include "../Utility/Frustum.h"
+#include "../Utility/HeightGrid.h"
 
 #include <SFML/Graphics/Image.hpp>
+#include <SFML/System/Clock.hpp>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/random.hpp>
 
+#include <algorithm>
 #include <sstream>
 #include <limits>
 
+// SSE2 intrinsics are available to every x86 build target of MSVC
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define HEIGHTMAP_SSE2
+#include <emmintrin.h>
+#endif
+
 using namespace glm;
 
+// Largest on-screen error allowed for a terrain chunk, in pixels
+static const float lodPixelError = 2.f;
+// Lines of the sun shadow swept, and rows of colors shaded from it, each frame
+static const unsigned int shadowLinesPerFrame = 16;
+// Cosine of how far the sun moves before shadows are swept again
+static const float shadowSunCosine = 0.99985f;   // 1 degree
+// Share of the vertex color left in full shadow, the rest is sunlight
+static const float shadowFloor = 0.5f;
+
+// Store the optional normal and slope results of one height query
+static inline void storeSlope( const unsigned int i
+							 , const float slopeX, const float slopeZ
+							 , vec3 *normals, vec2 *slopes )
+{
+	if( normals != nullptr ) normals[i] = normalize(vec3(-slopeX, 1.f, -slopeZ));
+	if( slopes  != nullptr ) slopes[i]  = vec2(slopeX, slopeZ);
+}
+
 
 HeightMap::HeightMap( const unsigned int width
 					, const unsigned int height
 					, const float groundScale
 					, const float heightScale
 					, const float offsetWidth
-					, const float offsetHeight )
+					, const float offsetHeight
+					, const unsigned int seed )
 	// TODO: update Mesh ctor to accept heightScale
 	: Mesh(width, height, groundScale)
 	, offset(offsetWidth, offsetHeight)
 	, groundScale(groundScale)
 	, heightScale(heightScale)
+	, seed(seed)
 	, imageName("")
+	, chunks()
+	, lod(true)
+	, chunksDirty(true)
+	, heightGrid()
+	, pyramid()
+	, horizonMap()
+	, albedo()
+	, sunShadow()
+	, shadowStale(true)
+	, shadowRow(0)
+	, edits()
+	, editing(false)
 {
 	updateVerticesByOffsets();
-	diamondSquare();
+	synthesizeHeights();
 	regenerateNormals();
+	copyHeights(0, 0, width - 1, height - 1);
+	bakeLighting();
 	setupTextures();
 }
 
@@ -42,177 +90,269 @@ HeightMap::HeightMap( const std::string& imageFilename
 					, const float heightScale /* = 20.f */
 					, const float offsetWidth
 					, const float offsetHeight )
-	: Mesh(imageFilename, groundScale, heightScale)
+	: Mesh()
 	, offset(offsetWidth, offsetHeight)
 	, groundScale(groundScale)
 	, heightScale(heightScale)
+	, seed(0)
 	, imageName(imageFilename)
+	, chunks()
+	, lod(true)
+	, chunksDirty(true)
+	, heightGrid()
+	, pyramid()
+	, horizonMap()
+	, albedo()
+	, sunShadow()
+	, shadowStale(true)
+	, shadowRow(0)
+	, edits()
+	, editing(false)
 {
-	updateVerticesByOffsets();
-	regenerateNormals();
-	setupTextures();
-}
+	// The cache is keyed on the source image and every parameter 
+	// that shapes the terrain, anything built from other inputs
+	// is ignored and replaced
+	const std::string source(ImageManager::get().findImageFile(imageFilename));
+	const std::string cacheFilename(source + ".cache");
+	TerrainCache::Key key = 0;
+	const bool cacheable = !source.empty() && TerrainCache::hashFile(source, key);
+	if( cacheable )
+	{
+		const float params[] = { groundScale, heightScale, offsetWidth, offsetHeight };
+		key = TerrainCache::hash(params, sizeof(params), key);
+	}
 
-void HeightMap::randomizeGaussian()
-{
-	for(unsigned int row = 0; row < height; ++row)
-	for(unsigned int col = 0; col < width;  ++col)
+	if( !cacheable || !loadCache(cacheFilename, key) )
 	{
-		glm::vec3& vertex = vertexAt(col, row);
-		vertex.y = static_cast<float>(glm::gaussRand(1.0, 0.4));
+		initialize(imageFilename, groundScale, heightScale, GL_TRIANGLES);
+		updateVerticesByOffsets();
+		regenerateNormals();
+		chunks.build(vertices, width, height);
+
+		if( cacheable )
+			saveCache(cacheFilename, key);
 	}
+	chunksDirty = false;
+
+	copyHeights(0, 0, width - 1, height - 1);
+	bakeLighting();
+	setupTextures();
 }
 
-float HeightMap::heightAt( const float col, const float row )
+bool HeightMap::loadCache( const std::string& filename, const TerrainCache::Key key )
 {
-	if( col < width * groundScale && row < height * groundScale )
-	{
-		const vec2 mapcoords(col / groundScale, row / groundScale);
+	TerrainCache cache;
+	if( !cache.open(filename, key) || cache.getWidth() < 2 || cache.getHeight() < 2 )
+		return false;
 
-		if( mapcoords.x >= 0 && mapcoords.y >= 0
-         && mapcoords.x < (width - 1) && mapcoords.y < (height - 1) )
-		{
-			const unsigned int x = static_cast<unsigned int>(mapcoords.x);
-			const unsigned int y = static_cast<unsigned int>(mapcoords.y);
+	mode   = GL_TRIANGLES;
+	spread = groundScale;
+	allocateArrays(cache.getWidth(), cache.getHeight());
 
-			const vec3& v0 = vertexAt(x  , y  );
-			const vec3& v1 = vertexAt(x  , y+1);
-			const vec3& v2 = vertexAt(x+1, y  );
-			const vec3& v3 = vertexAt(x+1, y+1);
+	// The arrays are stored exactly as the mesh holds them
+	std::copy(cache.getVertices(), cache.getVertices() + numVertices, vertices);
+	std::copy(cache.getNormals(),  cache.getNormals()  + numVertices, normals);
+	std::copy(cache.getColors(),   cache.getColors()   + numVertices, colors);
 
-			const float dx = mapcoords.x - x;
-			const float dy = mapcoords.y - y;
+	chunks.build(vertices, width, height, cache.getMeasures(), cache.getNumMeasures());
+	return true;
+}
 
-			// Interpolate height values between pairs 
-			// of vertices on either side of the square
-			const float h1 = v0.y + dy * (v1.y - v0.y);
-			const float h2 = v2.y + dy * (v3.y - v2.y);
+void HeightMap::saveCache( const std::string& filename, const TerrainCache::Key key ) const
+{
+	std::vector<TerrainChunks::Measure> measures;
+	chunks.getMeasures(measures);
+	TerrainCache::write(filename, key, width, height, vertices, normals, colors, measures);
+}
 
-			// Interpolate the height value between the 
-			// previously interpolated values
-			return (h1 + dx * (h2 - h1));
-		}
+void HeightMap::randomizeGaussian()
+{
+	for(unsigned int row = 0; row < height; ++row)
+	{
+		vec3 *vertex = vertexRow(row);
+		for(unsigned int col = 0; col < width; ++col)
+			vertex[col].y = static_cast<float>(glm::gaussRand(1.0, 0.4));
 	}
-/*
-	std::stringstream ss;
-	ss << "Warning: invalid bounds for HeightMap::heightAt"
-       << "(" << col << " , " << row << ")";
-	Log(ss);
-*/
-	return std::numeric_limits<float>::min();
 }
 
-void HeightMap::updateVerticesByOffsets()
+float HeightMap::heightAt( const float col, const float row )
 {
-	for(unsigned int z = 0; z < height; ++z)
-	for(unsigned int x = 0; x < width;  ++x)
-		vertexAt(x,z) += vec3(offset.x, 0.f, offset.y);
+	const vec2 point(col, row);
+	float y;
+	heightsAt(&point, 1, &y);
+	return y;
 }
 
-// Note: assumes a square 
-void HeightMap::diamondSquare( bool smooth /*= true*/ )
+void HeightMap::heightsAt( const vec2 *points
+						 , const unsigned int count
+						 , float *heights
+						 , vec3 *normals
+						 , vec2 *slopes ) const
 {
-	zeroHeightValues();
+	assert(count == 0 || (points != nullptr && heights != nullptr));
 
-	const unsigned int size = height; // and width
-	float heightRange = 500.f;//heightScale;
-
-	// Shrink sideLength and heightRange for each step
-	for(unsigned int sideLength = size - 1;	sideLength >= 2;
-		sideLength /= 2, heightRange *= 0.5f)
+	const float offMap = std::numeric_limits<float>::min();
+	if( width < 2 || height < 2 || heightGrid.getSize() != numVertices )
 	{
-		const unsigned int halfSide = sideLength / 2;
+		for(unsigned int i = 0; i < count; ++i)
+		{
+			heights[i] = offMap;
+			storeSlope(i, 0.f, 0.f, normals, slopes);
+		}
+		return;
+	}
 
-		// Do the square step
-		for(unsigned int z = 0; z < size; z += sideLength)
-		for(unsigned int x = 0; x < size; x += sideLength)
+	const float *grid = heightGrid.data();
+	const unsigned int w = width;
+	const float maxx = static_cast<float>(width  - 1);
+	const float maxz = static_cast<float>(height - 1);
+	const float invScale = 1.f / groundScale;
+	const bool derivatives = (normals != nullptr || slopes != nullptr);
+
+	unsigned int i = 0;
+#ifdef HEIGHTMAP_SSE2
+	const __m128 scale4  = _mm_set1_ps(groundScale);
+	const __m128 inv4    = _mm_set1_ps(invScale);
+	const __m128 zero4   = _mm_setzero_ps();
+	const __m128 maxx4   = _mm_set1_ps(maxx);
+	const __m128 maxz4   = _mm_set1_ps(maxz);
+	const __m128 offMap4 = _mm_set1_ps(offMap);
+
+	for(; i + 4 <= count; i += 4)
+	{
+		// Split four (col,row) pairs into map coordinates
+		const float *xz = &points[i].x;
+		const __m128 lo = _mm_loadu_ps(xz);
+		const __m128 hi = _mm_loadu_ps(xz + 4);
+		const __m128 mx = _mm_div_ps(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2,0,2,0)), scale4);
+		const __m128 mz = _mm_div_ps(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3,1,3,1)), scale4);
+
+		const __m128 valid = _mm_and_ps(
+			_mm_and_ps(_mm_cmpge_ps(mx, zero4), _mm_cmpge_ps(mz, zero4)),
+			_mm_and_ps(_mm_cmplt_ps(mx, maxx4), _mm_cmplt_ps(mz, maxz4)));
+
+		// Lanes off the map read the first square and are masked out later
+		const __m128  cx = _mm_and_ps(mx, valid);
+		const __m128  cz = _mm_and_ps(mz, valid);
+		const __m128i ix = _mm_cvttps_epi32(cx);
+		const __m128i iz = _mm_cvttps_epi32(cz);
+		const __m128  dx = _mm_sub_ps(cx, _mm_cvtepi32_ps(ix));
+		const __m128  dz = _mm_sub_ps(cz, _mm_cvtepi32_ps(iz));
+
+		int col[4], row[4];
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(col), ix);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(row), iz);
+
+		float h00[4], h01[4], h10[4], h11[4];
+		for(unsigned int k = 0; k < 4; ++k)
 		{
-			// Calculate average of corners
-			float avg = vertexAt(x,z).y
-                      + vertexAt(x + sideLength, z).y
-                      + vertexAt(x, z + sideLength).y
-                      + vertexAt(x + sideLength, z + sideLength).y;
-			avg *= 0.25f;
-
-			// Center is average plus random offset
-			const float rand = linearRand(-heightRange, heightRange);
-			vertexAt(x + halfSide, z + halfSide).y = avg + rand;
+			const float *cell = grid + row[k] * w + col[k];
+			h00[k] = cell[0];
+			h01[k] = cell[w];
+			h10[k] = cell[1];
+			h11[k] = cell[w + 1];
 		}
 
-		// Do the diamond step
-		for(unsigned int z = 0; z < size; z += halfSide)
-		for(unsigned int x = (z + halfSide) % sideLength;
-			x < size; x += halfSide)
+		// Same operations in the same order as the scalar loop below
+		const __m128 v0 = _mm_loadu_ps(h00);
+		const __m128 v2 = _mm_loadu_ps(h10);
+		const __m128 e0 = _mm_sub_ps(_mm_loadu_ps(h01), v0);
+		const __m128 e1 = _mm_sub_ps(_mm_loadu_ps(h11), v2);
+		const __m128 h1 = _mm_add_ps(v0, _mm_mul_ps(dz, e0));
+		const __m128 h2 = _mm_add_ps(v2, _mm_mul_ps(dz, e1));
+		const __m128 dh = _mm_sub_ps(h2, h1);
+		const __m128 h  = _mm_add_ps(h1, _mm_mul_ps(dx, dh));
+		_mm_storeu_ps(heights + i, _mm_or_ps(_mm_and_ps(valid, h), _mm_andnot_ps(valid, offMap4)));
+
+		if( derivatives )
 		{
-			// Calculate the average (mods are to wrap around edges)
-			float avg = vertexAt((z - halfSide + size) % size, x).y
-				+ vertexAt((x + halfSide) % size, z).y
-				+ vertexAt(x, (z + halfSide) % size).y
-				+ vertexAt(x, (z - halfSide + size) % size).y;
-			avg *= 0.25f;
-
-			// Center is average plus random offset
-			const float rand = linearRand(-heightRange, heightRange);
-			vertexAt(x, z).y = avg + rand;
-
-			// Wrap values on edges
-			if( z == 0 ) vertexAt(size - 1, z).y = avg;
-			if( x == 0 ) vertexAt(x, size - 1).y = avg;
+			float slopeX[4], slopeZ[4];
+			const __m128 de = _mm_add_ps(e0, _mm_mul_ps(dx, _mm_sub_ps(e1, e0)));
+			_mm_storeu_ps(slopeX, _mm_and_ps(valid, _mm_mul_ps(dh, inv4)));
+			_mm_storeu_ps(slopeZ, _mm_and_ps(valid, _mm_mul_ps(de, inv4)));
+			for(unsigned int k = 0; k < 4; ++k)
+				storeSlope(i + k, slopeX[k], slopeZ[k], normals, slopes);
 		}
 	}
+#endif
 
-	if( smooth )
+	for(; i < count; ++i)
 	{
-		// Smooth it a bunch 
-		for(unsigned int i = 0; i < 10; ++i)
-			smoothHeights();
-	}
+		const float mx = points[i].x / groundScale;
+		const float mz = points[i].y / groundScale;
+		if( !(mx >= 0.f && mz >= 0.f && mx < maxx && mz < maxz) )
+		{
+			heights[i] = offMap;
+			if( derivatives )
+				storeSlope(i, 0.f, 0.f, normals, slopes);
+			continue;
+		}
 
-	// Find max height value
-	float max = -9999999.0f;
-	for(unsigned int z = 0; z < height; ++z)
-	for(unsigned int x = 0; x < width;  ++x)
-	{
-		const float y = vertexAt(x, z).y;
-		if( y > max )
-			max = y;
+		const unsigned int x = static_cast<unsigned int>(mx);
+		const unsigned int z = static_cast<unsigned int>(mz);
+		const float dx = mx - x;
+		const float dz = mz - z;
+
+		// Interpolate height values between pairs 
+		// of vertices on either side of the square,
+		// then between the interpolated values
+		const float *cell = grid + z * w + x;
+		const float e0 = cell[w] - cell[0];
+		const float e1 = cell[w + 1] - cell[1];
+		const float h1 = cell[0] + dz * e0;
+		const float h2 = cell[1] + dz * e1;
+		const float dh = h2 - h1;
+		heights[i] = h1 + dx * dh;
+
+		if( derivatives )
+			storeSlope(i, dh * invScale, (e0 + dx * (e1 - e0)) * invScale, normals, slopes);
 	}
+}
 
-
-	// Rescale heights
-	for(unsigned int z = 0; z < height; ++z)
-	for(unsigned int x = 0; x < width;  ++x)
-		vertexAt(x, z).y = vertexAt(x, z).y / max * heightScale;
+void HeightMap::updateVerticesByOffsets()
+{
+	const vec3 delta(offset.x, 0.f, offset.y);
+	vec3 *vertex = vertexRow(0);
+	for(unsigned int i = 0; i < numVertices; ++i)
+		vertex[i] += delta;
 }
 
-void HeightMap::setupTextures()
+void HeightMap::synthesizeHeights( bool smooth /*= true*/ )
 {
-	float        ts = 0.1f;
-	unsigned int i  = 0;
+	HeightGrid grid(width, height);
 
-	// Load first texture
-	glm::vec2 *texcoord = new glm::vec2[numVertices];
+	// Tiles are placed by their offsets, so generate at that grid position
+	const int originX = static_cast<int>(floor(offset.x / groundScale + 0.5f));
+	const int originZ = static_cast<int>(floor(offset.y / groundScale + 0.5f));
 
-	i  = 0;
-	ts = 0.05f;
-	for(unsigned int z = 0; z < height; ++z)
-		for(unsigned int x = 0; x < width;  ++x)
-			texcoord[i++] = glm::vec2(x * ts, z * ts);
+	if( width == height && terraingen::isPowerOfTwoPlusOne(width) )
+		terraingen::diamondSquare(grid, seed, originX, originZ);
+	else
+		terraingen::fbm(grid, seed, originX, originZ);
 
-	sf::Image *tex = &GetImage("grass_256x256.png");
-	addTexture(tex, texcoord);
+	if( smooth )
+	{
+		// Smooth it a bunch, border samples are left alone so tiles still meet 
+		grid.smooth(10);
+	}
 
-	// Load second texture
-	glm::vec2 *detailTexCoord = new glm::vec2[numVertices];
+	// Rescale by a fixed amount rather than this tile's own peak,
+	// so neighboring tiles stay on the same scale
+	float *heights = grid.data();
+	for(unsigned int i = 0; i < grid.getSize(); ++i)
+		heights[i] *= heightScale;
+	grid.writeHeights(vertices);
+}
 
-	i  = 0;
-	ts = 0.1f;//01f;
-	for(unsigned int z = 0; z < height; ++z)
-		for(unsigned int x = 0; x < width;  ++x)
-			detailTexCoord[i++] = glm::vec2(x * ts, z * ts);
+void HeightMap::setupTextures()
+{
+	// Both layers tile with the grid, so their coordinates are 
+	// generated rather than stored for every vertex
+	sf::Image *tex = &GetImage("grass_256x256.png");
+	addTexture(tex, glm::vec2(0.05f));
 
 	sf::Image *detailTex = &GetImage("grass-detail.png");
-	addTexture(detailTex, detailTexCoord);
+	addTexture(detailTex, glm::vec2(0.1f));
 
 	// Setup default render states
 	light        = true;
@@ -221,57 +361,409 @@ void HeightMap::setupTextures()
 	multiTexture = true;
 }
 
-void HeightMap::zeroHeightValues()
+bool HeightMap::clipArea( const glm::vec2& minXZ
+						, const glm::vec2& maxXZ
+						, unsigned int& minx, unsigned int& minz
+						, unsigned int& maxx, unsigned int& maxz ) const
 {
-	for(unsigned int z = 0; z < height; ++z)
-	for(unsigned int x = 0; x < width;  ++x)
-		vertexAt(x,z).y = 0.f;
+	if( width == 0 || height == 0 || maxXZ.x < 0.f || maxXZ.y < 0.f )
+		return false;
+
+	minx = static_cast<unsigned int>(std::max(0.f, minXZ.x));
+	minz = static_cast<unsigned int>(std::max(0.f, minXZ.y));
+	maxx = std::min(static_cast<unsigned int>(maxXZ.x), width  - 1);
+	maxz = std::min(static_cast<unsigned int>(maxXZ.y), height - 1);
+
+	return (minx <= maxx && minz <= maxz);
 }
 
-void HeightMap::flattenArea( const glm::vec2& minXZ
-						   , const glm::vec2& maxXZ
-						   , float tolerance )
+void HeightMap::copyHeights( const unsigned int minx, const unsigned int minz
+						   , const unsigned int maxx, const unsigned int maxz )
 {
-	const unsigned int minx = static_cast<unsigned int>(minXZ.x);
-	const unsigned int minz = static_cast<unsigned int>(minXZ.y);
-	const unsigned int maxx = static_cast<unsigned int>(maxXZ.x);
-	const unsigned int maxz = static_cast<unsigned int>(maxXZ.y);
-
-	// First find average height level
-	float avgHeight = 0.f;
-	int count = 0;
-	for(unsigned int z = minz; z <= maxz; ++z)
-	for(unsigned int x = minx; x <= maxx; ++x)
+	if( heightGrid.getWidth() != width || heightGrid.getHeight() != height )
 	{
-		avgHeight += vertexAt(x, z).y;
-		++count;
+		heightGrid.resize(width, height);
+		heightGrid.readHeights(vertices);
+		pyramid.build(heightGrid);
+		return;
 	}
-	avgHeight /= count;
 
-	// Next, lower heights more than tolerance above avg
-	// and raise heights more than tolerance below avg
 	for(unsigned int z = minz; z <= maxz; ++z)
-	for(unsigned int x = minx; x <= maxx; ++x)
 	{
-		vec3& v = vertexAt(x, z);
-		if( v.y < avgHeight - tolerance ) v.y = avgHeight - tolerance;
-		if( v.y > avgHeight + tolerance ) v.y = avgHeight + tolerance;
+		const vec3 *src = vertexRow(z);
+		float *dst = heightGrid.row(z);
+		for(unsigned int x = minx; x <= maxx; ++x)
+			dst[x] = src[x].y;
 	}
+	pyramid.update(minx, minz, maxx, maxz);
+}
+
+HeightPyramid::Ray HeightMap::toGridRay( const vec3& origin
+									   , const vec3& direction
+									   , const float maxDistance ) const
+{
+	// Scaling the direction with the origin keeps distances the same
+	HeightPyramid::Ray ray;
+	ray.origin      = vec3((origin.x - offset.x) / groundScale, origin.y, (origin.z - offset.y) / groundScale);
+	ray.direction   = vec3(direction.x / groundScale, direction.y, direction.z / groundScale);
+	ray.maxDistance = maxDistance;
+	return ray;
+}
+
+bool HeightMap::raycast( const vec3& origin
+					   , const vec3& direction
+					   , const float maxDistance
+					   , float& distance ) const
+{
+	return pyramid.intersect(toGridRay(origin, direction, maxDistance), distance);
+}
+
+void HeightMap::raycast( const vec3 *origins
+					   , const vec3 *directions
+					   , const float *maxDistances
+					   , const unsigned int count
+					   , float *distances ) const
+{
+	std::vector<HeightPyramid::Ray> rays(count);
+	for(unsigned int i = 0; i < count; ++i)
+		rays[i] = toGridRay(origins[i], directions[i], maxDistances[i]);
+
+	if( count > 0 )
+		pyramid.intersect(&rays[0], count, distances);
+}
+
+bool HeightMap::lineOfSight( const vec3& from, const vec3& to ) const
+{
+	// Segment ends are allowed to touch the ground
+	float distance;
+	return !raycast(from, to - from, 1.f, distance) || distance >= 1.f;
+}
+
+void HeightMap::lineOfSight( const vec3 *from
+						   , const vec3 *to
+						   , const unsigned int count
+						   , bool *visible ) const
+{
+	std::vector<HeightPyramid::Ray> rays(count);
+	for(unsigned int i = 0; i < count; ++i)
+		rays[i] = toGridRay(from[i], to[i] - from[i], 1.f);
+
+	std::vector<float> distances(count);
+	if( count > 0 )
+		pyramid.intersect(&rays[0], count, &distances[0]);
+
+	for(unsigned int i = 0; i < count; ++i)
+		visible[i] = (distances[i] < 0.f || distances[i] >= 1.f);
+}
+
+void HeightMap::beginEdit()
+{
+	editing = true;
+}
+
+void HeightMap::commitEdit()
+{
+	editing = false;
+	applyEdits();
+}
+
+void HeightMap::flattenArea( const glm::vec2& minXZ
+						   , const glm::vec2& maxXZ
+						   , float tolerance )
+{
+	queueEdit(EditOp::flatten_tolerance, minXZ, maxXZ, tolerance);
 }
 
 void HeightMap::flattenArea( float height
 						   , const glm::vec2& minXZ
 						   , const glm::vec2& maxXZ)
 {
-	const unsigned int minx = static_cast<unsigned int>(minXZ.x);
-	const unsigned int minz = static_cast<unsigned int>(minXZ.y);
-	const unsigned int maxx = static_cast<unsigned int>(maxXZ.x);
-	const unsigned int maxz = static_cast<unsigned int>(maxXZ.y);
+	queueEdit(EditOp::flatten_height, minXZ, maxXZ, height);
+}
 
-	for(unsigned int z = minz; z <= maxz; ++z)
-	for(unsigned int x = minx; x <= maxx; ++x)
+void HeightMap::raiseArea( float delta
+						 , const glm::vec2& minXZ
+						 , const glm::vec2& maxXZ )
+{
+	queueEdit(EditOp::raise, minXZ, maxXZ, delta);
+}
+
+void HeightMap::smoothArea( const glm::vec2& minXZ
+						  , const glm::vec2& maxXZ
+						  , unsigned int iterations /* = 1 */ )
+{
+	queueEdit(EditOp::smooth, minXZ, maxXZ, 0.f, iterations);
+}
+
+void HeightMap::queueEdit( const EditOp::Type type
+						 , const glm::vec2& minXZ, const glm::vec2& maxXZ
+						 , const float value, const unsigned int iterations )
+{
+	EditOp edit;
+	if( !clipArea(minXZ, maxXZ, edit.rect.minx, edit.rect.minz, edit.rect.maxx, edit.rect.maxz) )
+		return;
+
+	edit.type       = type;
+	edit.value      = value;
+	edit.iterations = iterations;
+	edits.push_back(edit);
+
+	if( !editing )
+		applyEdits();
+}
+
+void HeightMap::applyEdits()
+{
+	if( edits.empty() )
+		return;
+
+	// Edits go in order since later ones can read earlier results,
+	// everything derived from the heights waits for the last one
+	std::vector<GridRect> dirty;
+	for each(const auto& edit in edits)
+	{
+		applyEdit(edit);
+		addDirtyRect(dirty, edit.rect);
+	}
+	edits.clear();
+
+	for each(const auto& rect in dirty)
+		heightsChanged(rect.minx, rect.minz, rect.maxx, rect.maxz);
+}
+
+void HeightMap::applyEdit( const EditOp& edit )
+{
+	const GridRect& r(edit.rect);
+
+	switch( edit.type )
+	{
+	case EditOp::flatten_tolerance:
+		{
+			// First find average height level
+			float avgHeight = 0.f;
+			int count = 0;
+			for(unsigned int z = r.minz; z <= r.maxz; ++z)
+			{
+				const vec3 *row = vertexRow(z);
+				for(unsigned int x = r.minx; x <= r.maxx; ++x)
+					avgHeight += row[x].y;
+				count += r.maxx - r.minx + 1;
+			}
+			avgHeight /= count;
+
+			// Next, lower heights more than tolerance above avg
+			// and raise heights more than tolerance below avg
+			const float lo = avgHeight - edit.value;
+			const float hi = avgHeight + edit.value;
+			for(unsigned int z = r.minz; z <= r.maxz; ++z)
+			{
+				vec3 *row = vertexRow(z);
+				for(unsigned int x = r.minx; x <= r.maxx; ++x)
+					row[x].y = std::min(std::max(row[x].y, lo), hi);
+			}
+		}
+		break;
+
+	case EditOp::flatten_height:
+		for(unsigned int z = r.minz; z <= r.maxz; ++z)
+		{
+			vec3 *row = vertexRow(z);
+			for(unsigned int x = r.minx; x <= r.maxx; ++x)
+				row[x].y = edit.value;
+		}
+		break;
+
+	case EditOp::raise:
+		for(unsigned int z = r.minz; z <= r.maxz; ++z)
+		{
+			vec3 *row = vertexRow(z);
+			for(unsigned int x = r.minx; x <= r.maxx; ++x)
+				row[x].y += edit.value;
+		}
+		break;
+
+	case EditOp::smooth:
+		{
+			// Filter a copy with enough of a border that the area comes
+			// out as smoothing the whole grid would leave it
+			const unsigned int border = edit.iterations;
+			const unsigned int x0 = r.minx - std::min(r.minx, border);
+			const unsigned int z0 = r.minz - std::min(r.minz, border);
+			const unsigned int x1 = std::min(r.maxx + border, width  - 1);
+			const unsigned int z1 = std::min(r.maxz + border, height - 1);
+
+			HeightGrid grid(x1 - x0 + 1, z1 - z0 + 1);
+			for(unsigned int z = z0; z <= z1; ++z)
+			{
+				const vec3 *row = vertexRow(z);
+				float *dst = grid.row(z - z0);
+				for(unsigned int x = x0; x <= x1; ++x)
+					dst[x - x0] = row[x].y;
+			}
+
+			grid.smooth(edit.iterations);
+
+			for(unsigned int z = r.minz; z <= r.maxz; ++z)
+			{
+				vec3 *row = vertexRow(z);
+				const float *src = grid.row(z - z0);
+				for(unsigned int x = r.minx; x <= r.maxx; ++x)
+					row[x].y = src[x - x0];
+			}
+		}
+		break;
+	}
+}
+
+void HeightMap::addDirtyRect( std::vector<GridRect>& dirty, GridRect rect )
+{
+	// Normals of a rectangle reach one vertex past it, so rectangles 
+	// that close are merged rather than have the rows between them 
+	// regenerated twice. A merge can reach others, so start over.
+	for(unsigned int i = 0; i < dirty.size(); )
+	{
+		const GridRect& other(dirty[i]);
+		if( rect.minx <= other.maxx + 2 && other.minx <= rect.maxx + 2
+		 && rect.minz <= other.maxz + 2 && other.minz <= rect.maxz + 2 )
+		{
+			rect.minx = std::min(rect.minx, other.minx);
+			rect.minz = std::min(rect.minz, other.minz);
+			rect.maxx = std::max(rect.maxx, other.maxx);
+			rect.maxz = std::max(rect.maxz, other.maxz);
+			dirty.erase(dirty.begin() + i);
+			i = 0;
+		}
+		else
+			++i;
+	}
+	dirty.push_back(rect);
+}
+
+void HeightMap::heightsChanged( const unsigned int minx, const unsigned int minz
+							  , const unsigned int maxx, const unsigned int maxz )
+{
+	regenerateNormals(minx, minz, maxx, maxz);
+	copyHeights(minx, minz, maxx, maxz);
+
+	// Built chunks only need the ones under the change measured again
+	if( chunks.isBuilt() && !chunksDirty )
+		chunks.remeasure(minx, minz, maxx, maxz);
+	else
+		chunksDirty = true;
+
+	// Any vertex looking across the change along one of the baked
+	// directions can see a different horizon
+	if( horizonMap.isBaked() )
+	{
+		std::vector<unsigned int> shaded;
+		horizonMap.update(heightGrid, minx, minz, maxx, maxz, shaded);
+		if( !shaded.empty() )
+		{
+			unsigned int minRow = height, maxRow = 0;
+			for each(auto i in shaded)
+			{
+				shadeVertex(i);
+				minRow = std::min(minRow, i / width);
+				maxRow = std::max(maxRow, i / width);
+			}
+			markDirty(minRow, maxRow);
+		}
+	}
+
+	shadowStale = true;
+	notifyChanged(minx, minz, maxx, maxz);
+}
+
+void HeightMap::updateSunShadow( const vec3& sunDirection )
+{
+	// A sweep always runs to the end so shadows keep up however 
+	// fast the sun moves, and every night is equally dark
+	bool finished = false;
+	if( !sunShadow.isSweeping() )
 	{
-		vec3& v = vertexAt(x, z);
-		v.y = height;
+		const vec3& swept = sunShadow.getSunDirection();
+		const bool night  = (sunDirection.y <= 0.f && swept.y <= 0.f);
+		if( shadowStale || (!night && dot(sunDirection, swept) < shadowSunCosine) )
+		{
+			finished = sunShadow.begin(heightGrid, groundScale, sunDirection);
+			shadowStale = false;
+		}
+	}
+	if( sunShadow.step(heightGrid, shadowLinesPerFrame) )
+		finished = true;
+
+	// Colors are shaded from the finished sweep a band of rows a frame
+	// too, so only those rows are uploaded again. Lines swept across
+	// columns would touch every row, so this waits for the whole sweep
+	// and the next can start meanwhile.
+	if( finished )
+		shadowRow = 0;
+	if( shadowRow < height )
+	{
+		const unsigned int lastRow = std::min(height, shadowRow + shadowLinesPerFrame);
+		for(unsigned int i = shadowRow * width; i < lastRow * width; ++i)
+			shadeVertex(i);
+		markDirty(shadowRow, lastRow - 1);
+		shadowRow = lastRow;
 	}
+}
+
+void HeightMap::bakeLighting()
+{
+	sf::Clock clock;
+
+	albedo.resize(numVertices);
+	for(unsigned int i = 0; i < numVertices; ++i)
+	{
+		const vec4 c(clamp(colors[i], 0.f, 1.f) * 255.f + 0.5f);
+		albedo[i] = sf::Color(static_cast<sf::Uint8>(c.r), static_cast<sf::Uint8>(c.g)
+							, static_cast<sf::Uint8>(c.b), static_cast<sf::Uint8>(c.a));
+	}
+
+	horizonMap.bake(heightGrid, groundScale);
+	for(unsigned int i = 0; i < numVertices; ++i)
+		shadeVertex(i);
+	markDirty();
+	shadowRow = height;
+
+	std::stringstream ss;
+	ss << "Baked terrain horizons over " << width << "x" << height 
+	   << " vertices in " << clock.GetElapsedTime() << " seconds";
+	Log(ss);
+}
+
+void HeightMap::shadeVertex( const unsigned int i )
+{
+	const sf::Color& c = albedo[i];
+	// The albedo is in bytes, scale it to [0,1] along with the shade
+	const float sun   = shadowFloor + (1.f - shadowFloor) * sunShadow.getLight(i);
+	const float shade = horizonMap.getAmbient(i) * sun / 255.f;
+	colors[i] = vec4(vec3(c.r, c.g, c.b) * shade, c.a / 255.f);
+}
+
+void HeightMap::selectLod( const Camera& camera )
+{
+	if( chunksDirty )
+	{
+		chunks.build(vertices, width, height);
+		chunksDirty = false;
+	}
+
+	// Pixels spanned by one world unit seen from unit distance
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	const float pixelsPerUnit = 0.5f * viewport[3] * camera.projection()[1][1];
+
+	// With lod off only lossless simplification is allowed,
+	// but chunks outside the view are still skipped
+	const Frustum frustum(camera.projection(), camera.view());
+	chunks.select(frustum, camera.position(), pixelsPerUnit, lod ? lodPixelError : 0.f);
+}
+
+void HeightMap::drawElements() const
+{
+	if( mode == GL_TRIANGLES && chunks.isBuilt() )
+		chunks.draw();
+	else
+		Mesh::drawElements();
 }
\ No newline at end of file
@@ -4,36 +4,92 @@
 /* ---------
 /* A basic height map mesh
 /************************************************************************/
+#include "TerrainChunks.h"
+#include "TerrainCache.h"
 #include "../Utility/Mesh.h"
 #include "../Utility/Logger.h"
+#include "../Utility/HeightGrid.h"
+#include "../Utility/HeightPyramid.h"
+#include "../Utility/HorizonMap.h"
+#include "../Utility/SunShadow.h"
+
+#include <SFML/Graphics/Color.hpp>
 
 #include <glm/glm.hpp>
 
+class Camera;
+
 
 class HeightMap : public Mesh
 {
 private:
+	// An inclusive rectangle of vertices
+	struct GridRect
+	{
+		unsigned int minx, minz;
+		unsigned int maxx, maxz;
+	};
+
+	// A terrain edit waiting for commitEdit()
+	struct EditOp
+	{
+		enum Type { flatten_tolerance, flatten_height, raise, smooth };
+
+		Type type;
+		GridRect rect;
+		float value;              // tolerance, height or delta
+		unsigned int iterations;  // smoothing passes
+	};
+
 	std::string  imageName;
 	glm::vec2 offset;
 	float heightScale;
 	float groundScale;
+	unsigned int seed;
+
+	TerrainChunks chunks;
+	bool lod;
+	bool chunksDirty;    // heights changed since chunks were built
+
+	// Copy of the vertex heights for terrain queries
+	HeightGrid heightGrid;
+	HeightPyramid pyramid;
+
+	// Baked horizons, the vertex colors are the unshaded albedo
+	// darkened by the ambient term of each vertex
+	HorizonMap horizonMap;
+	std::vector<sf::Color> albedo;
+
+	// Sun shadows, swept a few lines a frame and applied on top
+	// of the ambient term a few rows a frame once a sweep completes
+	SunShadow sunShadow;
+	bool shadowStale;    // heights changed since the last sweep began
+	unsigned int shadowRow;   // rows before this are shaded from the last complete sweep
+
+	std::vector<EditOp> edits;
+	bool editing;
 
 public:
 	/**
 	 * Creates a new heightmap with the specified parameters
 	 * by using the diamond-square algorithm to generate 
-	 * height values procedurally
+	 * height values procedurally (or fractal noise when the
+	 * size isn't a square of 2^n+1 vertices)
 	 * \param width  - number of vertices wide
 	 * \param height - number of vertices long
 	 * \param groundScale - distance between vertices in the plane
 	 * \param heightScale - distance between vertices vertically
+	 * \param seed - picks the terrain, heightmaps with the same seed
+	 *               and size placed side by side by their offsets 
+	 *               match along their shared edges
 	**/
 	HeightMap(const unsigned int width  = 100
 			, const unsigned int height = 100
 			, const float groundScale   = 1.f
 			, const float heightScale   = 20.f
 			, const float offsetWidth   = 0.f
-			, const float offsetHeight  = 0.f);
+			, const float offsetHeight  = 0.f
+			, const unsigned int seed   = 0);
 
 	/**
 	 * Creates a new heightmap by loading height data from an image 
@@ -59,20 +115,148 @@ public:
 	float heightAt(const float col  
                  , const float row);
 
+	/**
+	 * Look up many heights at once, as heightAt() would for each
+	 * point, interpolating four points at a time where SSE is available
+	 * \param points  - the (col, row) positions to lookup
+	 * \param count   - the number of points
+	 * \param heights - receives the height at each point, or the
+	 *                  smallest possible float for points off the map
+	 * \param normals - if not null, receives the surface normal at
+	 *                  each point, straight up for points off the map
+	 * \param slopes  - if not null, receives the height change per 
+	 *                  unit along x and z at each point, zero off the map
+	**/
+	void heightsAt(const glm::vec2 *points
+				 , const unsigned int count
+				 , float *heights
+				 , glm::vec3 *normals = nullptr
+				 , glm::vec2 *slopes  = nullptr) const;
+
+	/**
+	 * Cast a ray against the terrain surface as it is drawn
+	 * \param origin    - world space start of the ray
+	 * \param direction - world space direction, distances are in 
+	 *                    multiples of its length
+	 * \param maxDistance - how far along the ray to look
+	 * \param distance  - receives the distance to the first point
+	 *                    at or below the surface
+	 * \return - true if the ray hits within maxDistance
+	**/
+	bool raycast(const glm::vec3& origin
+			   , const glm::vec3& direction
+			   , const float maxDistance
+			   , float& distance) const;
+
+	/**
+	 * Cast many rays against the terrain at once
+	 * \param origins, directions, maxDistances - count rays as in raycast()
+	 * \param distances - receives each hit distance, negative for misses
+	**/
+	void raycast(const glm::vec3 *origins
+			   , const glm::vec3 *directions
+			   , const float *maxDistances
+			   , const unsigned int count
+			   , float *distances) const;
+
+	// True if the segment between the points stays above the terrain
+	bool lineOfSight(const glm::vec3& from, const glm::vec3& to) const;
+	// Test count segments at once
+	void lineOfSight(const glm::vec3 *from
+				   , const glm::vec3 *to
+				   , const unsigned int count
+				   , bool *visible) const;
+
 	float getHeightScale() const;
 	float getGroundScale() const;
 
+	/**
+	 * Queue the area edits below until commitEdit(), which applies
+	 * them in order and then brings normals, the height grid, the 
+	 * ray casting pyramid and chunks up to date once over the merged
+	 * changed rectangles. Queries see the terrain as it was before 
+	 * beginEdit() until the commit. Outside of beginEdit() and 
+	 * commitEdit() each edit is applied right away.
+	**/
+	void beginEdit();
+	void commitEdit();
+	bool isEditing() const;
+
+	// Pull heights in an area to within tolerance of their average
 	void flattenArea(const glm::vec2& minXZ, const glm::vec2& maxXZ, float tolerance);
+	// Set every height in an area
 	void flattenArea(float height, const glm::vec2& minXZ, const glm::vec2& maxXZ);
+	// Move heights in an area up by delta, or down if it's negative
+	void raiseArea(float delta, const glm::vec2& minXZ, const glm::vec2& maxXZ);
+	// Apply 3x3 box filter passes to the heights in an area, reading
+	// the heights around it but leaving them unchanged
+	void smoothArea(const glm::vec2& minXZ, const glm::vec2& maxXZ, unsigned int iterations = 1);
+
+	// Pick the level of detail of each terrain chunk for this camera
+	// and hide the chunks it can't see
+	void selectLod(const Camera& camera);
+	void toggleLod();
+	const TerrainChunks& getChunks() const;
+	const HorizonMap& getHorizonMap() const;
+
+	// Sweep this frame's share of the sun shadow, starting a new
+	// sweep once the last has finished and the sun has moved or
+	// the heights changed, and shade this frame's share of the
+	// vertex colors from the last complete sweep
+	void updateSunShadow(const glm::vec3& sunDirection);
+
+protected:
+	// Draw the visible chunks instead of the full resolution grid
+	virtual void drawElements() const;
 
 private:
-	void diamondSquare(bool smooth = true);
+	void synthesizeHeights(bool smooth = true);
+	// Fill the mesh and chunks from a terrain cache file built 
+	// for the given key, false if there's no usable one
+	bool loadCache(const std::string& filename, const TerrainCache::Key key);
+	void saveCache(const std::string& filename, const TerrainCache::Key key) const;
+	// Queue an edit over an area, applying it now outside of an edit
+	void queueEdit( const EditOp::Type type
+				  , const glm::vec2& minXZ, const glm::vec2& maxXZ
+				  , const float value, const unsigned int iterations = 0 );
+	// Apply the queued edits and update what depends on the heights
+	void applyEdits();
+	// Change the vertex heights under one edit
+	void applyEdit(const EditOp& edit);
+	// Add a rectangle to a set of changed rectangles, merging it with 
+	// any whose normals it would touch
+	static void addDirtyRect(std::vector<GridRect>& dirty, GridRect rect);
+	// Bake the horizons of every vertex and shade the vertex colors
+	// by them, keeping the current colors as the albedo
+	void bakeLighting();
+	// Set a vertex color from its albedo, baked ambient term and
+	// sun shadow
+	void shadeVertex(const unsigned int i);
+	// Bring normals, the height grid, chunks and baked shading up to
+	// date after an inclusive rectangle of vertex heights changed
+	void heightsChanged( const unsigned int minx, const unsigned int minz
+					   , const unsigned int maxx, const unsigned int maxz );
+	// Convert an area in grid coordinates to inclusive vertex bounds
+	// clipped to the grid, false if none of it is on the grid
+	bool clipArea( const glm::vec2& minXZ, const glm::vec2& maxXZ
+				 , unsigned int& minx, unsigned int& minz
+				 , unsigned int& maxx, unsigned int& maxz ) const;
+	// Refresh heightGrid over an inclusive rectangle of vertices
+	void copyHeights( const unsigned int minx, const unsigned int minz
+					, const unsigned int maxx, const unsigned int maxz );
+	// World space ray to the grid space the pyramid works in
+	HeightPyramid::Ray toGridRay( const glm::vec3& origin
+								, const glm::vec3& direction
+								, const float maxDistance ) const;
 	void randomizeGaussian();
 	void updateVerticesByOffsets();
 	void setupTextures();
-	void zeroHeightValues();
 };
 
 
 inline float HeightMap::getHeightScale() const {return heightScale;}
 inline float HeightMap::getGroundScale() const {return groundScale;}
+inline void  HeightMap::toggleLod() { lod = !lod; }
+inline bool  HeightMap::isEditing() const { return editing; }
+inline const TerrainChunks& HeightMap::getChunks() const { return chunks; }
+inline const HorizonMap& HeightMap::getHorizonMap() const { return horizonMap; }
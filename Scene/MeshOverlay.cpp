@@ -5,13 +5,39 @@
 /************************************************************************/
 #include "MeshOverlay.h"
 #include "../Utility/Mesh.h"
+#include "../Utility/Logger.h"
 #include "../Core/ImageManager.h"
 
 #include <glm/glm.hpp>
 
+#include <algorithm>
+#include <cmath>
+
 using namespace glm;
 
 
+namespace
+{
+	// Keeps the overlay from fighting with the parent for depth
+	const float lift = 0.01f;
+
+	// Curve samples per path segment when measuring its length
+	const unsigned int samplesPerSegment = 16;
+
+	// Point on the Catmull-Rom segment from p1 to p2 at t in [0,1]
+	vec2 catmullRom( const vec2& p0, const vec2& p1
+				   , const vec2& p2, const vec2& p3, const float t )
+	{
+		const float t2 = t * t;
+		const float t3 = t2 * t;
+		return 0.5f * ((2.f * p1) 
+					 + (p2 - p0) * t 
+					 + (2.f * p0 - 5.f * p1 + 4.f * p2 - p3) * t2 
+					 + (3.f * p1 - p0 - 3.f * p2 + p3) * t3);
+	}
+}
+
+
 MeshOverlay::MeshOverlay( Mesh& parent
                         , const unsigned int width   /* = 60  */
                         , const unsigned int height  /* = 500 */
@@ -21,18 +47,49 @@ MeshOverlay::MeshOverlay( Mesh& parent
 	, parent(parent)
 	, offsetw(offsetw)
 	, offseth(offseth)
+	, drape()
+	, rowSpans()
+	, listener(0)
 {
 	// initialize vertices based on offset and parent
 	regenerateVertices();
 
-	// initialize texture
-	glm::vec2 *texcoord = new glm::vec2[numVertices];
+	// initialize texture, stretched once across and repeating along
+	sf::Image *tex = &GetImage("road.png");
+	addTexture(tex, glm::vec2(1.f / (width - 1), 0.1f));
 
-	unsigned int i  = 0;
-	float ts = 0.1f;
-	for(unsigned int z = 0; z < height; ++z)
+	fill = true;
+	texture = true;
+	light = true;
+//	normalsVis = true;
+
+	listener = parent.addChangeListener(
+		[this](unsigned int minx, unsigned int minz, unsigned int maxx, unsigned int maxz) {
+			parentChanged(minx, minz, maxx, maxz);
+		});
+}
+
+MeshOverlay::MeshOverlay( Mesh& parent
+						, const std::vector<vec2>& path
+						, const float stripWidth
+						, const unsigned int width  /* = 16  */
+						, const unsigned int height /* = 512 */ )
+	: Mesh(width, height, parent.getSpread())
+	, parent(parent)
+	, offsetw(0)
+	, offseth(0)
+	, drape()
+	, rowSpans()
+	, listener(0)
+{
+	layoutPath(path, stripWidth);
+	regenerateVertices();
+
+	// Texgen can't follow the curve, so this layer is stored
+	vec2 *texcoord = new vec2[numVertices];
+	for(unsigned int z = 0, i = 0; z < height; ++z)
 	for(unsigned int x = 0; x < width;  ++x)
-		texcoord[i++] = glm::vec2(x * 1.f / (width-1), z * ts);
+		texcoord[i++] = vec2(x * 1.f / (width - 1), z * 0.1f);
 
 	sf::Image *tex = &GetImage("road.png");
 	addTexture(tex, texcoord);
@@ -40,28 +97,197 @@ MeshOverlay::MeshOverlay( Mesh& parent
 	fill = true;
 	texture = true;
 	light = true;
-//	normalsVis = true;
+
+	listener = parent.addChangeListener(
+		[this](unsigned int minx, unsigned int minz, unsigned int maxx, unsigned int maxz) {
+			parentChanged(minx, minz, maxx, maxz);
+		});
+}
+
+MeshOverlay::~MeshOverlay()
+{
+	parent.removeChangeListener(listener);
 }
 
 void MeshOverlay::regenerateVertices()
 {
-	for(unsigned int z = 0; z < height; ++z)
-	for(unsigned int x = 0; x < width;  ++x)
+	if( parent.getWidth() == 0 || parent.getHeight() == 0 )
+		return;
+	parentChanged(0, 0, parent.getWidth() - 1, parent.getHeight() - 1);
+}
+
+void MeshOverlay::parentChanged( const unsigned int minx, const unsigned int minz
+							   , const unsigned int maxx, const unsigned int maxz )
+{
+	if( followsPath() )
+	{
+		// Rows along a path can come back over the same ground, 
+		// so each run of touched rows is draped separately
+		for(unsigned int z = 0; z < height; )
+		{
+			const RowSpan& span(rowSpans[z]);
+			if( span.minx > maxx || span.maxx < minx || span.minz > maxz || span.maxz < minz )
+			{
+				++z;
+				continue;
+			}
+
+			const unsigned int first = z;
+			while( z + 1 < height 
+				&& !(rowSpans[z + 1].minx > maxx || rowSpans[z + 1].maxx < minx
+				  || rowSpans[z + 1].minz > maxz || rowSpans[z + 1].maxz < minz) )
+				++z;
+			drapeRows(first, z);
+			++z;
+		}
+		return;
+	}
+
+	// Overlay vertex (x, z) sits on parent vertex (x + offsetw, z + offseth)
+	if( maxx < offsetw || maxz < offseth )
+		return;
+	const unsigned int x0 = (minx > offsetw) ? minx - offsetw : 0;
+	const unsigned int z0 = (minz > offseth) ? minz - offseth : 0;
+	const unsigned int x1 = std::min(maxx - offsetw, width  - 1);
+	const unsigned int z1 = std::min(maxz - offseth, height - 1);
+	if( x0 > x1 || z0 > z1 )
+		return;
+
+	const Mesh& source = parent;
+	for(unsigned int z = z0; z <= z1; ++z)
 	{
-		vec3& vertex = vertexAt(x,z);
-		const unsigned int offsetx = x + offsetw;
+		vec3 *vertex = vertexRow(z);
 		const unsigned int offsetz = z + offseth;
-		if( offsetx < parent.getWidth() && offsetz < parent.getHeight() )
+		const vec3 *parentRow = (offsetz < source.getHeight()) ? source.vertexRow(offsetz) : nullptr;
+
+		for(unsigned int x = x0; x <= x1; ++x)
+		{
+			const unsigned int offsetx = x + offsetw;
+			if( parentRow != nullptr && offsetx < source.getWidth() )
+			{
+				vertex[x] = parentRow[offsetx];
+				vertex[x].y += lift;
+			}
+			else
+			{
+				const float s = source.getSpread();
+				vertex[x] = vec3(offsetx * s, 0, offsetz * s);
+			}
+		}
+	}
+
+	regenerateNormals(x0, z0, x1, z1);
+}
+
+void MeshOverlay::layoutPath( const std::vector<vec2>& path, const float stripWidth )
+{
+	drape.clear();
+	rowSpans.clear();
+	if( path.size() < 2 || width < 2 || height < 2 )
+	{
+		Log("Warning: an overlay path needs at least two points");
+		return;
+	}
+
+	// Sample the spline finely, the ends are repeated so it runs 
+	// through every point
+	std::vector<vec2> curve;
+	const unsigned int last = path.size() - 1;
+	for(unsigned int i = 0; i < last; ++i)
+	{
+		const vec2& p0 = path[(i > 0) ? i - 1 : 0];
+		const vec2& p3 = path[std::min(i + 2, last)];
+		for(unsigned int s = 0; s < samplesPerSegment; ++s)
+			curve.push_back(catmullRom(p0, path[i], path[i + 1], p3, s / static_cast<float>(samplesPerSegment)));
+	}
+	curve.push_back(path[last]);
+
+	std::vector<float> distance(curve.size(), 0.f);
+	for(unsigned int i = 1; i < curve.size(); ++i)
+		distance[i] = distance[i - 1] + length(curve[i] - curve[i - 1]);
+
+	// Rows are spaced evenly by distance along the curve
+	const float s = parent.getSpread();
+	const vec3& origin(parent.vertexRow(0)[0]);
+	const float maxCol = static_cast<float>(parent.getWidth()  - 1);
+	const float maxRow = static_cast<float>(parent.getHeight() - 1);
+
+	drape.resize(numVertices);
+	rowSpans.resize(height);
+	unsigned int segment = 0;
+	for(unsigned int z = 0; z < height; ++z)
+	{
+		const float along = distance.back() * z / (height - 1);
+		while( segment + 2 < curve.size() && distance[segment + 1] < along )
+			++segment;
+
+		const vec2& a = curve[segment];
+		const vec2& b = curve[segment + 1];
+		const float span = distance[segment + 1] - distance[segment];
+		const float t = (span > 0.f) ? (along - distance[segment]) / span : 0.f;
+		const vec2 center(a + (b - a) * std::min(std::max(t, 0.f), 1.f));
+		const vec2 tangent((span > 0.f) ? (b - a) / span : vec2(0.f, 1.f));
+		// Turned so columns run across as x does for the parent, 
+		// keeping the triangles facing up
+		const vec2 side(tangent.y, -tangent.x);
+
+		RowSpan& rowSpan(rowSpans[z]);
+		rowSpan.minx = rowSpan.minz = ~0u;
+		rowSpan.maxx = rowSpan.maxz = 0;
+		for(unsigned int x = 0; x < width; ++x)
 		{
-			vertex = parent.vertexAt(offsetx, offsetz);
-			vertex.y += 0.01f;
+			const vec2 point(center + side * stripWidth * (x / static_cast<float>(width - 1) - 0.5f));
+			const vec2 grid(std::min(std::max((point.x - origin.x) / s, 0.f), maxCol)
+						  , std::min(std::max((point.y - origin.z) / s, 0.f), maxRow));
+			drape[z * width + x] = grid;
+
+			// Heights come from the square around the point
+			const unsigned int col = static_cast<unsigned int>(grid.x);
+			const unsigned int row = static_cast<unsigned int>(grid.y);
+			rowSpan.minx = std::min(rowSpan.minx, col);
+			rowSpan.minz = std::min(rowSpan.minz, row);
+			rowSpan.maxx = std::max(rowSpan.maxx, col + 1);
+			rowSpan.maxz = std::max(rowSpan.maxz, row + 1);
 		}
-		else
+	}
+}
+
+void MeshOverlay::drapeRows( const unsigned int firstRow, const unsigned int lastRow )
+{
+	const float s = parent.getSpread();
+	const vec3& origin(parent.vertexRow(0)[0]);
+
+	for(unsigned int z = firstRow; z <= lastRow; ++z)
+	{
+		vec3 *vertex = vertexRow(z);
+		const vec2 *grid = &drape[z * width];
+		for(unsigned int x = 0; x < width; ++x)
 		{
-			const float s = parent.getSpread();
-			vertex = vec3(offsetx * s, 0, offsetz * s);
+			vertex[x] = vec3(origin.x + grid[x].x * s
+						   , parentHeight(grid[x]) + lift
+						   , origin.z + grid[x].y * s);
 		}
 	}
 
-	regenerateNormals();
+	regenerateNormals(0, firstRow, width - 1, lastRow);
+}
+
+float MeshOverlay::parentHeight( const vec2& point ) const
+{
+	const Mesh& source = parent;
+	const unsigned int x0 = std::min(static_cast<unsigned int>(point.x), source.getWidth()  - 2);
+	const unsigned int z0 = std::min(static_cast<unsigned int>(point.y), source.getHeight() - 2);
+	const float u = point.x - x0;
+	const float v = point.y - z0;
+
+	// Same split as the parent's triangles, so the strip follows
+	// the surface that is drawn rather than a smoothed one
+	const vec3 *row0 = source.vertexRow(z0);
+	const vec3 *row1 = source.vertexRow(z0 + 1);
+	const float h00 = row0[x0].y, h10 = row0[x0 + 1].y;
+	const float h01 = row1[x0].y, h11 = row1[x0 + 1].y;
+	if( u + v <= 1.f )
+		return h00 + u * (h10 - h00) + v * (h01 - h00);
+	else
+		return h11 + (1.f - u) * (h01 - h11) + (1.f - v) * (h10 - h11);
 }
@@ -8,25 +8,71 @@
 
 #include <glm/glm.hpp>
 
+#include <vector>
+
 
 class MeshOverlay : public Mesh 
 {
 protected:
+	// Parent vertices an overlay row reads, inclusive
+	struct RowSpan
+	{
+		unsigned int minx, minz;
+		unsigned int maxx, maxz;
+	};
+
 	Mesh& parent;
 	unsigned int offsetw;
 	unsigned int offseth;
 
+	// Position of each vertex in the parent's grid for overlays that 
+	// follow a path, empty for ones that copy a block of the parent
+	std::vector<glm::vec2> drape;
+	std::vector<RowSpan>   rowSpans;
+
+	unsigned int listener;
+
 public:
+	// Copy a block of the parent's vertices, starting at the given
+	// column and row offsets
 	MeshOverlay( Mesh& parent
                , const unsigned int width   = 16
                , const unsigned int height  = 512 
                , const unsigned int offsetw = 60
                , const unsigned int offseth = 0 );
 
+	// Lay a strip stripWidth wide along a Catmull-Rom spline through
+	// points on the parent's x,z plane, width vertices across and 
+	// height vertices spaced evenly along it
+	MeshOverlay( Mesh& parent
+			   , const std::vector<glm::vec2>& path
+			   , const float stripWidth
+			   , const unsigned int width  = 16
+			   , const unsigned int height = 512 );
+
+	~MeshOverlay();
+
+	// Drape every vertex over the parent again
 	void regenerateVertices();
 
 	const glm::vec2 getOffset() const;
+	bool followsPath() const;
+
+private:
+	// Drape the vertices that read an inclusive rectangle of the
+	// parent's vertices, called whenever the parent changes
+	void parentChanged( const unsigned int minx, const unsigned int minz
+					  , const unsigned int maxx, const unsigned int maxz );
+
+	// Place the path vertices along the spline and find the parent
+	// vertices each row reads
+	void layoutPath(const std::vector<glm::vec2>& path, const float stripWidth);
+	// Drape rows [firstRow, lastRow] of a path overlay
+	void drapeRows(const unsigned int firstRow, const unsigned int lastRow);
+	// Height of the parent's triangles at a point in its grid
+	float parentHeight(const glm::vec2& point) const;
 };
 
 
 inline const glm::vec2 MeshOverlay::getOffset() const {return glm::vec2(offsetw, offseth);}
+inline bool MeshOverlay::followsPath() const { return !drape.empty(); }
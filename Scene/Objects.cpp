@@ -7,6 +7,7 @@
 
 #include "Objects.h"
 #include "Skybox.h"
+#include "FluidManager.h"
 #include "../Particles/Particles.h"
 #include "../Utility/RenderUtils.h"
 #include "../Core/Common.h"
@@ -33,6 +34,7 @@ Fish::Fish(vec3 pos, Color color, HeightMap& heightmap, Fluid& fluid)
 	, posNeg(0)
 	, direction(Randomizer::Random(0,1) * 2 -1)
 	, theta(0.f)
+	, depth(fluid.pos.y - pos.y)
 	, fluid(fluid)
 	, heightmap(heightmap)
 	, quadric(gluNewQuadric())
@@ -67,6 +69,12 @@ void Fish::update(const Clock &clock, const sf::Input& input)
 		transform[3][0] = transform[3][0] + (randx * cos(theta)) + (randz * sin(theta));
 		transform[3][2] = transform[3][2] + (randz * cos(theta)) + (randx * sin(theta));
 	}
+
+	// Ride up and down with the waves overhead
+	const vec2 xz(transform[3][0], transform[3][2]);
+	float surface = fluid.pos.y;
+	fluid.sampleSurface(&xz, 1, &surface);
+	transform[3][1] = surface - depth;
 }
 
 void Fish::draw(const Camera& camera)
@@ -130,11 +138,12 @@ void Fish::draw(const Camera& camera)
 /* A fountain consisting of a fluid surface, a particle emitter that 
 /* disturbs the fluid surface, and some containing geometry
 /************************************************************************/
-Fountain::Fountain(vec3 pos, float size, ParticleEmitter& emitter, Skybox *skybox)
+Fountain::Fountain(vec3 pos, float size, ParticleEmitter& emitter, Skybox *skybox, FluidManager& fluidMgr)
 	: SceneObject(pos)
 	, count(0)
 	, size(size)
 	, fluid(nullptr)
+	, fluidMgr(fluidMgr)
 	, texture(GetImage("fountain.png"))
 	, emitter(emitter)
 {
@@ -150,6 +159,7 @@ Fountain::Fountain(vec3 pos, float size, ParticleEmitter& emitter, Skybox *skybo
 	);
 	fluid->setSkybox(skybox);
 	fluid->blend = false;
+	fluidMgr.add(fluid);
 
 	texture.Bind();
 	glEnable(GL_TEXTURE_2D);
@@ -159,11 +169,15 @@ Fountain::Fountain(vec3 pos, float size, ParticleEmitter& emitter, Skybox *skybo
 
 Fountain::~Fountain()
 {
-	delete fluid;
+	fluidMgr.remove(fluid);
 }
 
 void Fountain::update(const Clock &clock, const sf::Input& input)
 {
+	// Gather this frame's surface impacts, then splat them in one batch
+	splats.clear();
+	const float scale = 1.f / (emitter.getMaxParticles() * 100);
+
 	std::for_each(emitter.getParticles().begin(), emitter.getParticles().end(),
 			[&](Particle& particle)
 	{
@@ -181,14 +195,13 @@ void Fountain::update(const Clock &clock, const sf::Input& input)
 		}
 		if(particle.position.y <= fluid->pos.y)
 		{
-			fluid->displace( translated.x
-						   , translated.z
-						   , 1.f / (emitter.getMaxParticles() * 100)
-						   , particle.velocity.y * 2.5f);
+			splats.push_back(FluidSplat( translated.x
+									   , translated.z
+									   , scale * particle.velocity.y * 2.5f ));
 			particle.active = false;
 		}
 	});
-	fluid->evaluate();
+	fluid->displace(splats);
 }
 
 void Fountain::draw(const Camera& camera)
@@ -16,6 +16,7 @@
 #include <SFML\Graphics.hpp>
 
 class Skybox;
+class FluidManager;
 
 
 /************************************************************************/
@@ -28,6 +29,7 @@ private:
 	int posNeg;
 	int direction;
 	float theta;
+	float depth;   // how far below the fluid surface to swim
 	Fluid& fluid;
 	HeightMap& heightmap;
 	GLUquadricObj* quadric;
@@ -55,15 +57,19 @@ private:
 	int count;
 	float size;
 	Fluid* fluid;
+	FluidSplats splats;
+	FluidManager& fluidMgr;
 	sf::Image texture;
 	GLUquadricObj* quadric;
 	ParticleEmitter& emitter;
 
 public:
+	// The fountain's fluid surface is owned and stepped by fluidMgr
 	Fountain( glm::vec3 pos
 			, float size
 			, ParticleEmitter& emitter
-			, Skybox* skybox );
+			, Skybox* skybox
+			, FluidManager& fluidMgr );
 
 	~Fountain();
 
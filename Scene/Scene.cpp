@@ -14,6 +14,8 @@
 #include "../Utility/ObjModel.h"
 #include "../Utility/RenderUtils.h"
 #include "../Utility/BoundingBox.h"
+#include "../Utility/BoundsGrid.h"
+#include "../Utility/PoissonScatter.h"
 #include "../Core/Common.h"
 #include "../Core/ImageManager.h"
 #include "../Particles/Particles.h"
@@ -21,6 +23,7 @@
 #include <functional>
 #include <algorithm>
 #include <sstream>
+#include <limits>
 #include <iostream>
 
 #include <glm/glm.hpp>
@@ -43,17 +46,47 @@ ParticleEmitter *followee = nullptr;
 // TODO: keep a container of mobile stuff in Scene
 ModelObject *car = nullptr;
 
+// Random spots tried for the fish before giving up on the rest
+static const unsigned int maxPlacementTries = 1000;
+
+namespace
+{
+	// Keeps scattered objects on ground between two heights that's
+	// no steeper than a slope, given as the least y of its normal
+	struct GroundMask
+	{
+		const HeightMap *terrain;
+		float minHeight;
+		float maxHeight;
+		float minUp;
+
+		GroundMask(const HeightMap *terrain, float minHeight, float maxHeight, float minUp)
+			: terrain(terrain), minHeight(minHeight), maxHeight(maxHeight), minUp(minUp)
+		{ }
+
+		float operator()(const vec2& p) const
+		{
+			float y;
+			vec3 normal;
+			terrain->heightsAt(&p, 1, &y, &normal);
+			return (y >= minHeight && y <= maxHeight && normal.y >= minUp) ? 1.f : 0.f;
+		}
+	};
+}
+
 
 Scene::Scene()
 	: camera(nullptr)
 	, cameras()
 	, skybox()
 	, fluid(nullptr)
+	, heightmap(nullptr)
     , lights()
 	, meshes()
 	, objects()
 	, bounds()
 	, particleMgr()
+	, fluidMgr()
 	, meshOverlay(nullptr)
 	, timer()
 { }
@@ -102,7 +135,7 @@ void Scene::setup()
 
 	// setup meshes ----------------------------------------------
 //	HeightMap *heightmap = new HeightMap(256, 256, 2.f);
-	HeightMap *heightmap = new HeightMap("heightmap-terrain.png", 1.f, 100.f); 
+	heightmap = new HeightMap("heightmap-terrain.png", 1.f, 100.f); 
 //	HeightMap *heightmap2 = new HeightMap("heightmap-terrain.png", 2.f, 100.f, 256.f, 256.f); 
 //	HeightMap *heightmap3 = new HeightMap("heightmap-terrain.png", 2.f, 100.f, 256.f, 0.f);
 	
@@ -112,13 +145,34 @@ void Scene::setup()
 
 	meshOverlay = new MeshOverlay(*heightmap);//, 10, 600, -5, 5);
 	BoundingBox *bb = new BoundingBox(*meshOverlay);
-	bounds.push_back(bb);
 
-	// Flatten HeightMap under MeshOverlay
+	// Placed objects' bounds are indexed on a grid over the terrain
+	// so a candidate spot is only tested against the bounds near it
+	BoundsGrid placed( vec2(0.f)
+					 , vec2(heightmap->getWidth(), heightmap->getHeight()) * heightmap->getGroundScale()
+					 , 16.f );
+	auto addBounds = [&](BoundingBox *box)
+	{
+		bounds.push_back(box);
+		placed.insert(box->getEdges()[0], box->getEdges()[1]);
+	};
+	addBounds(bb);
+
+	// True if nothing placed so far stands over any of a box's ground,
+	// whatever their heights, so flattening under it changes no height
+	// read for another object and the edits can wait to be applied together
+	const float tall = std::numeric_limits<float>::max();
+	auto groundClear = [&](BoundingBox *box) -> bool
+	{
+		const vec3& lo = box->getEdges()[0];
+		const vec3& hi = box->getEdges()[1];
+		return !placed.overlaps(vec3(lo.x, -tall, lo.z), vec3(hi.x, tall, hi.z));
+	};
+
+	// Flatten HeightMap under MeshOverlay, right away since the car reads it
 	vec2 minXZ(bb->getEdges()[0].x, bb->getEdges()[0].z);
 	vec2 maxXZ(bb->getEdges()[1].x, bb->getEdges()[1].z);
 	heightmap->flattenArea(minXZ, maxXZ, 10.f);
-	meshOverlay->regenerateVertices();
 
 	// generate a new fluid surface ------------------------------
 	fluid = new Fluid(
@@ -134,55 +188,23 @@ void Scene::setup()
 			 0.1f * heightmap->getWidth() * heightmap->getGroundScale())
 	);
 	fluid->setSkybox(&skybox);
+	fluidMgr.add(fluid);
+
+	addBounds(new BoundingBox(*fluid));
 
-	bounds.push_back(new BoundingBox(*fluid));
+	// Spots for each kind of object are drawn from a blue noise scatter
+	// over dry, gentle ground, clear of the bounds placed before it. 
+	// Each spot is still checked against the object's exact bounds.
+	const vec2 mapSize(vec2(heightmap->getWidth(), heightmap->getHeight()) * heightmap->getGroundScale());
+	const GroundMask dryLand(heightmap, fluid->pos.y, std::numeric_limits<float>::max(), 0.8f);
+	PoissonScatter scatter(vec2(0.f), mapSize, static_cast<unsigned int>(rand()));
+	std::vector<vec2> spots;
 	
 	// add Scene objects -----------------------------------------
-	const unsigned int numHouses = 5;
-	for(unsigned int i = 0; i < numHouses; ++i)
-	{
-		bool boolBound = false;
-		const float x = linearRand(50.f, heightmap->getWidth()*heightmap->getGroundScale());		//kinda cheating way to prevent buildings from landing on road
-		const float z = linearRand(5.f, heightmap->getHeight()*heightmap->getGroundScale());
-		const vec3 pos(x, heightmap->heightAt(x,z), z);
-		const float house = linearRand(0.f, 4.f);
-		const float roof = linearRand(0.f, 2.f);
-		const float length = linearRand(5.f, 20.f);
-		const float width = linearRand(5.f, 20.f);
-		const float height = linearRand(5.f, 10.f);
-		House* building = new House(pos, sf::Color(0, 255, 0), house, roof, length, width, height);
-		BoundingBox* buildingbb = new BoundingBox(*building, vec3(pos.x - width - 1, pos.y - height, pos.z - length - 1), vec3(pos.x + width + 1, pos.y + height*2, pos.z + length + 1));
-		
-		//UGLY... to prevent weird edge behavior (no sides, or no flattening, etc)
-		if(	buildingbb->getEdges()[0].x < 0 ||
-			buildingbb->getEdges()[1].x > heightmap->getWidth()*heightmap->getGroundScale() ||
-			buildingbb->getEdges()[0].z < 0 ||
-			buildingbb->getEdges()[1].z > heightmap->getHeight()*heightmap->getGroundScale())
-		{
-			delete building;
-			delete buildingbb;
-			i--;
-			continue;
-		}
-
-		for each(auto bound in bounds)
-		{
-			if(bound->intersect(buildingbb))		//TODO: fix the super crappy way I wrote this
-			{
-				delete building;
-				delete buildingbb;
-				i--;
-				boolBound = true;
-				break;
-			}
-		}
-		if(boolBound) continue;
-		objects.push_back(building);
-		bounds.push_back(buildingbb);
-		minXZ = vec2(buildingbb->getEdges()[0].x, buildingbb->getEdges()[0].z);
-		maxXZ = vec2(buildingbb->getEdges()[1].x, buildingbb->getEdges()[1].z);
-		heightmap->flattenArea(buildingbb->getEdges()[0].y, minXZ, maxXZ);
-	}
+	// Heights below are only read at fixed spots off each other's
+	// flattened ground, or inside an object's own bounds after checking
+	// groundClear, so their edits are applied together
+	heightmap->beginEdit();
 
 	// Add the goodyear blimp
 	objects.push_back(new Blimp(vec3(120, 150, 80), 10));
@@ -192,10 +214,11 @@ void Scene::setup()
 
 	// Add the house model
 	const vec3 housePos(193.5, heightmap->heightAt(193.5, 258.5) + 4.f, 258.5);
-	ModelObject* house = new ModelObject(housePos, "./Resources/models/house/house.obj", *heightmap, 7.f);
-	objects.push_back(house);
-	// Manually flatten area under house
+	ModelObject* houseModel = new ModelObject(housePos, "./Resources/models/house/house.obj", *heightmap, 7.f);
+	objects.push_back(houseModel);
+	// Manually flatten area under house, and keep others off it and the rod
 	heightmap->flattenArea(vec2(185.f, 250.5f), vec2(201.5, 266.5), 0.1f);
+	placed.insert(vec3(185.f, -tall, 249.f), vec3(201.5f, tall, 266.5f));
 
 	// Add campfire near house
 	const vec3 firePosition(housePos + vec3(-1.5f, -6.f, 10.f));
@@ -205,7 +228,7 @@ void Scene::setup()
 	Campfire* campfire  = new Campfire(firePosition, *fire, *smoke, 3.f);
 	objects.push_back(campfire);
 	bb = new BoundingBox(*campfire, glm::vec3(firePosition.x - 5, firePosition.y - 5, firePosition.z - 5) , glm::vec3(firePosition.x + 5, firePosition.y + 5, firePosition.z + 5));
-	bounds.push_back(bb);
+	addBounds(bb);
 	minXZ = vec2(bb->getEdges()[0].x, bb->getEdges()[0].z);
 	maxXZ = vec2(bb->getEdges()[1].x, bb->getEdges()[1].z);
 	heightmap->flattenArea(minXZ, maxXZ, 0.1f);
@@ -220,41 +243,82 @@ void Scene::setup()
 	objects.push_back(carModel);
 	car = carModel;
 
+	scatter.scatter(40.f, spots, dryLand, &placed, 8.f);
+	const unsigned int numHouses = 5;
+	for(unsigned int i = 0; i < numHouses && !spots.empty(); ++i)
+	{
+		const float x = spots.back().x;
+		const float z = spots.back().y;
+		spots.pop_back();
+		const vec3 pos(x, heightmap->heightAt(x,z), z);
+		const float house = linearRand(0.f, 4.f);
+		const float roof = linearRand(0.f, 2.f);
+		const float length = linearRand(5.f, 20.f);
+		const float width = linearRand(5.f, 20.f);
+		const float height = linearRand(5.f, 10.f);
+		House* building = new House(pos, sf::Color(0, 255, 0), house, roof, length, width, height);
+		BoundingBox* buildingbb = new BoundingBox(*building, vec3(pos.x - width - 1, pos.y - height, pos.z - length - 1), vec3(pos.x + width + 1, pos.y + height*2, pos.z + length + 1));
+		
+		//UGLY... to prevent weird edge behavior (no sides, or no flattening, etc)
+		if(	buildingbb->getEdges()[0].x < 0 ||
+			buildingbb->getEdges()[1].x > heightmap->getWidth()*heightmap->getGroundScale() ||
+			buildingbb->getEdges()[0].z < 0 ||
+			buildingbb->getEdges()[1].z > heightmap->getHeight()*heightmap->getGroundScale())
+		{
+			delete building;
+			delete buildingbb;
+			i--;
+			continue;
+		}
+
+		if( !groundClear(buildingbb) )
+		{
+			delete building;
+			delete buildingbb;
+			i--;
+			continue;
+		}
+		objects.push_back(building);
+		addBounds(buildingbb);
+		minXZ = vec2(buildingbb->getEdges()[0].x, buildingbb->getEdges()[0].z);
+		maxXZ = vec2(buildingbb->getEdges()[1].x, buildingbb->getEdges()[1].z);
+		heightmap->flattenArea(buildingbb->getEdges()[0].y, minXZ, maxXZ);
+	}
+
 	// Add several windmills
+	spots.clear();
+	scatter.scatter(30.f, spots, dryLand, &placed, 10.f);
 	const unsigned int numWindmills = 3;
-	for(unsigned int i = 0; i < numWindmills; ++i)
+	for(unsigned int i = 0; i < numWindmills && !spots.empty(); ++i)
 	{
-		bool boolBound = false;
-		const float x = linearRand(5.f, heightmap->getWidth()*heightmap->getGroundScale());
-		const float z = linearRand(5.f, heightmap->getHeight()*heightmap->getGroundScale());
+		const float x = spots.back().x;
+		const float z = spots.back().y;
+		spots.pop_back();
 		const vec3 pos(x, heightmap->heightAt(x,z), z);
 
 		Windmill* windmill = new Windmill(pos, *heightmap, 50.f);
 		BoundingBox* windbb = new BoundingBox(*windmill, vec3(pos.x - 10, pos.y, pos.z - 10), vec3(pos.x + 10, pos.y + 60, pos.z + 10));
-		for each(auto bound in bounds)
+		if( !groundClear(windbb) )
 		{
-			if(bound->intersect(windbb))		//TODO: fix the super crappy way I wrote this
-			{
-				delete windmill;
-				delete windbb;
-				i--;
-				boolBound = true;
-				break;
-			}
+			delete windmill;
+			delete windbb;
+			i--;
+			continue;
 		}
-		if(boolBound) continue;
 		objects.push_back(windmill);
-		bounds.push_back(windbb);
+		addBounds(windbb);
 		vec2 minXZ = vec2(windbb->getEdges()[0].x, windbb->getEdges()[0].z);
 		vec2 maxXZ = vec2(windbb->getEdges()[1].x, windbb->getEdges()[1].z);
 		heightmap->flattenArea(windbb->getEdges()[0].y - .1f, minXZ, maxXZ);
 	}
+
+	// Fish go anywhere under the water, so they see the edited ground
+	heightmap->commitEdit();
 	
 	// Add lots of fish
 	const unsigned int numFish = 15;
-	for(unsigned int i = 0; i < numFish; ++i)
+	for(unsigned int i = 0, tries = 0; i < numFish && tries < maxPlacementTries; ++i, ++tries)
 	{
-		bool boolBound = false;
 		const float x = linearRand(fluid->pos.x * fluid->getDist(), fluid->getWidth() * fluid->getDist());
 		const float z = linearRand(fluid->pos.z * fluid->getDist(), fluid->getHeight() * fluid->getDist());
 		vec3 pos(x, heightmap->heightAt(x,z), z);
@@ -267,14 +331,18 @@ void Scene::setup()
 		objects.push_back(new Fish(pos, sf::Color(255, 127, 0), *heightmap, *fluid));
 	}
 
+	heightmap->beginEdit();
+
 	// Add several campfires
 	ParticleSystem  *system3 = new ParticleSystem();
+	spots.clear();
+	scatter.scatter(15.f, spots, dryLand, &placed, 5.f);
 	const unsigned int numFires = 6;
-	for(unsigned int i = 0; i < numFires; ++i)
+	for(unsigned int i = 0; i < numFires && !spots.empty(); ++i)
 	{
-		bool boolBound = false;
-		const float x = linearRand(5.f, heightmap->getWidth()*heightmap->getGroundScale());
-		const float z = linearRand(5.f, heightmap->getHeight()*heightmap->getGroundScale());
+		const float x = spots.back().x;
+		const float z = spots.back().y;
+		spots.pop_back();
 		const vec3 pos(x, heightmap->heightAt(x,z)  + 2.f, z);
 		
 		const vec3 firePosition(pos.x, pos.y + 1.f, pos.z);
@@ -285,23 +353,18 @@ void Scene::setup()
 		BoundingBox* firebb = new BoundingBox(*campfire,glm::vec3(pos.x - 5, pos.y + 1, pos.z - 5) , 
 														glm::vec3(pos.x + 5, pos.y + 5, pos.z + 5));
 
-		for each(auto bound in bounds)
+		if( !groundClear(firebb) )
 		{
-			if(bound->intersect(firebb))		//TODO: fix the super crappy way I wrote this
-			{
-				delete fire;
-				delete smoke;
-				delete campfire;
-				delete firebb;
-				i--;
-				boolBound = true;
-				break;
-			}
+			delete fire;
+			delete smoke;
+			delete campfire;
+			delete firebb;
+			i--;
+			continue;
 		}
-		if(boolBound) continue;
 
 		objects.push_back(campfire);
-		bounds.push_back(firebb);
+		addBounds(firebb);
 		system3->add(fire);
 		system3->add(smoke);
 		minXZ = vec2(firebb->getEdges()[0].x, firebb->getEdges()[0].z);
@@ -312,61 +375,52 @@ void Scene::setup()
 		
 	// Add several fountains
 	ParticleSystem  *system1 = new ParticleSystem();
+	spots.clear();
+	scatter.scatter(20.f, spots, dryLand, &placed, 6.f);
 	const unsigned int numFountains = 4;
-	for(unsigned int i = 0; i < numFountains; ++i)
+	for(unsigned int i = 0; i < numFountains && !spots.empty(); ++i)
 	{
-		bool boolBound = false;
-		const float x = linearRand(5.f, heightmap->getWidth()*heightmap->getGroundScale());
-		const float z = linearRand(5.f, heightmap->getHeight()*heightmap->getGroundScale());
+		const float x = spots.back().x;
+		const float z = spots.back().y;
+		spots.pop_back();
 		const vec3 pos(x, heightmap->heightAt(x,z)  + 2.f, z);
 		
 		//const vec3 fountainPosition(40.f, heightmap->heightAt(40, 100) + 2.f, 100.f);
 		FountainEmitter *fountain = new FountainEmitter(pos, 20);
-		Fountain* foun = new Fountain(pos - vec3(0,1.f,0), 10, *fountain, &skybox);
+		Fountain* foun = new Fountain(pos - vec3(0,1.f,0), 10, *fountain, &skybox, fluidMgr);
 		BoundingBox* founbb = new BoundingBox(*foun,	glm::vec3(pos.x - 6, pos.y - 1.5, pos.z - 11) , 
 														glm::vec3(pos.x + 6, pos.y + 1, pos.z + 11));
 
-		for each(auto bound in bounds)
+		if( !groundClear(founbb) )
 		{
-			if(bound->intersect(founbb))		//TODO: fix the super crappy way I wrote this
-			{
-				delete fountain;
-				delete founbb;
-				delete foun;
-				i--;
-				boolBound = true;
-				break;
-			}
+			delete fountain;
+			delete founbb;
+			delete foun;
+			i--;
+			continue;
 		}
-		if(boolBound) continue;
 
 		objects.push_back(foun);
-		bounds.push_back(founbb);
+		addBounds(founbb);
 		system1->add(fountain);
 		minXZ = vec2(founbb->getEdges()[0].x, founbb->getEdges()[0].z);
 		maxXZ = vec2(founbb->getEdges()[1].x, founbb->getEdges()[1].z);
 		heightmap->flattenArea(founbb->getEdges()[0].y - .1f, minXZ, maxXZ);
 	}
 
+	heightmap->commitEdit();
+
 
 	// add transparent scene objects -----------------------------
+	// bushes take steeper ground than buildings
+	spots.clear();
+	scatter.scatter(6.f, spots, GroundMask(heightmap, fluid->pos.y, std::numeric_limits<float>::max(), 0.6f), &placed, 1.f);
 	const unsigned int numBushes = 50;
-	for(unsigned int i = 0; i < numBushes; ++i)
+	for(unsigned int i = 0; i < numBushes && i < spots.size(); ++i)
 	{
-		bool boolBound = false;
-		const float x = linearRand(5.f, 512.f);
-		const float z = linearRand(5.f, 512.f);
+		const float x = spots[i].x;
+		const float z = spots[i].y;
 		const vec3 pos(x, heightmap->heightAt(x,z), z);
-		for each(auto bound in bounds)
-		{
-			if(bound->inBox(pos))		//TODO: fix the super crappy way I wrote this
-			{
-				i--;
-				boolBound = true;
-				break;
-			}
-		}
-		if(boolBound) continue;
 		alphaObjects.push_back(new Plant(pos)); 
 	}
 
@@ -469,7 +523,15 @@ void Scene::update( const Clock& clock, const Input& input )
 	const vec3 followPos = followee->getPos();
 	const vec3 offsetPos = followPos + vec3(-30, 8, -30);
 	const float y = h->heightAt(offsetPos.x, offsetPos.z);
-	cameras[1].position(offsetPos.x, y + 10.f, offsetPos.z);
+	vec3 followCamPos(offsetPos.x, y + 10.f, offsetPos.z);
+
+	// Pull the camera in front of any hill between it and the followee
+	const vec3 toCamera(followCamPos - followPos);
+	float blocked;
+	if( h->raycast(followPos, toCamera, 1.f, blocked) && blocked > 0.f )
+		followCamPos = followPos + toCamera * std::max(0.f, blocked - 1.f / length(toCamera));
+
+	cameras[1].position(followCamPos);
 	cameras[1].lookAt(cameras[1].position(), followPos, up); 
 
 	// update scene objects
@@ -500,13 +562,17 @@ void Scene::update( const Clock& clock, const Input& input )
 	{
 		float x = linearRand(0.f, (float)fluid->getWidth());
 		float z = linearRand(0.f, (float)fluid->getHeight());
-		if(h->heightAt(x*fluid->getDist() + fluid->pos.x, z*fluid->getDist() + fluid->pos.z) > fluid->pos.y)	return;
-		fluid->displace( x
-                       , z
-					   , 1.f, linearRand(0.2f, 2.2f));
-		accum = 0.f;
+		if(h->heightAt(x*fluid->getDist() + fluid->pos.x, z*fluid->getDist() + fluid->pos.z) <= fluid->pos.y)
+		{
+			fluid->displace( x
+						   , z
+						   , 1.f, linearRand(0.2f, 2.2f));
+			accum = 0.f;
+		}
 	}
-	fluid->evaluate();
+
+	// step every fluid surface in the scene together
+	fluidMgr.update();
 
 //	std::cout << "timer: " << std::setw(10) << timer.GetElapsedTime() << "   "
 //		      << "clock: " << std::setw(10) << clock.GetElapsedTime() << std::endl; 
@@ -523,6 +589,7 @@ void Scene::render( const Clock& clock )
 
 	skybox.render(*camera);
 
+	heightmap->selectLod(*camera);
 	for each(auto mesh in meshes)
 		mesh->render();
 
@@ -573,6 +640,21 @@ void Scene::handle(const Event& event)
 			(*meshes.front()).toggleNormalsVis();
 		if( event.Key.Code == Key::Num7 )
 			(*meshes.front()).toggleMultiTexturing();
+		if( event.Key.Code == Key::Num8 )
+			heightmap->toggleLod();
+		if( event.Key.Code == Key::Num9 )
+		{
+			const TerrainChunks& chunks = heightmap->getChunks();
+			const TerrainChunks::Stats& stats = chunks.getStats();
+			std::stringstream ss;
+			ss << "Terrain: " << stats.visibleChunks << " of " << chunks.getNumChunks() 
+			   << " chunks visible, " << stats.numTriangles << " of " 
+			   << heightmap->getNumTriangles() << " triangles drawn, " 
+			   << stats.nodesTested << " quadtree nodes tested";
+			const vertexcache::Stats cache = chunks.measureVertexCache();
+			ss << ", vertex cache ACMR " << cache.acmr << " ATVR " << cache.atvr;
+			Log(ss);
+		}
 		// Mouse look toggle
 		if( event.Key.Code == Key::RControl )
 			camera->toggleMouseLook();
@@ -588,14 +670,19 @@ void Scene::handle(const Event& event)
 		if( event.MouseButton.Button == sf::Mouse::Left )
 		{
 			static const float distance = 25.f;
+			static const float maxPickDistance = 1000.f;
 
 			const vec3 campos(camera->position());
 			const vec3 viewdir(camera->getViewDir());
-			const vec3 offset(distance * viewdir);
 
-			// Spawn a particle system in front of the camera
+			// Spawn a particle system where the camera is looking at
+			// the ground, or a fixed distance ahead if it isn't
+			float hit = distance;
+			if( !heightmap->raycast(campos, viewdir, maxPickDistance, hit) )
+				hit = distance;
+
 			ParticleSystem *ps = new ParticleSystem();
-			ps->add(new ExplosionEmitter(campos + offset));
+			ps->add(new ExplosionEmitter(campos + hit * viewdir));
 			ps->start();
 			particleMgr.add(ps);
 		}
@@ -633,6 +720,7 @@ void Scene::cleanup()
 	for each(auto mesh in meshes)
 		delete mesh;
 	meshes.clear();
+	heightmap = nullptr;
 
 	for each(auto model in models)
 		delete model;
@@ -642,7 +730,9 @@ void Scene::cleanup()
 		delete light;
 	lights.clear();	
 
-	delete fluid;
+	// fountains have already handed back their surfaces
+	fluidMgr.clean();
+	fluid = nullptr;
 }
 
 void Scene::sortTransparentObjects()
@@ -669,6 +759,9 @@ void Scene::updateLights()
 	vec4 ambient(delta, delta, delta, 1.f);
 	glLightModelfv(GL_LIGHT_MODEL_AMBIENT, value_ptr(ambient));
 
+	// terrain shadows follow the sun across the sky
+	heightmap->updateSunShadow(skybox.getSunDirection());
+
 	// move lights around 
 /*
 	static float limit = constants::two_pi;
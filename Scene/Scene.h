@@ -10,6 +10,7 @@
 #include "HeightMap.h"
 #include "MeshOverlay.h"
 #include "SceneObject.h"
+#include "FluidManager.h"
 #include "../Core/Common.h"
 #include "../Utility/Mesh.h"
 #include "../Utility/Plane.h"
@@ -46,6 +47,7 @@ protected:
 	CameraVector    cameras;     // all the cameras in the scene
 	Skybox          skybox;      // the current skybox
 	Fluid          *fluid;       // a test fluid surface
+	HeightMap      *heightmap;   // the terrain, also owned by meshes
 	Lights          lights;      // a container of lights
 	Models          models;      // container of 3d models
 	Meshes          meshes;      // container of mesh objects
@@ -53,6 +55,7 @@ protected:
 	SceneObjects    alphaObjects;// transparent scene objects
 	BoundingBoxes	bounds;		//holds bounding boxes for objects
 	ParticleManager particleMgr; // handler for particle systems
+	FluidManager    fluidMgr;    // owns and steps all fluid surfaces
 
 
 	MeshOverlay    *meshOverlay; // test mesh overlay
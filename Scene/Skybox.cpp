@@ -70,6 +70,7 @@ Skybox::Skybox()
 	, timer()
 	, toggleDayNight(true)
 	, dayNightCycleDelta(0.f)
+	, sunDirection(0.f, -1.f, 0.f)
 {
 	if( !init() )
 		throw exception("Error initializing skybox.");
@@ -149,6 +150,15 @@ void Skybox::render(const Camera& camera)
 	// Day-night cycle delta [0,1]
 	dayNightCycleDelta = deltaTime / timeLimit;
 
+	// The sun climbs out of the east while the day fades in
+	// and sinks into the west while it fades out
+	const float elevation = glm::radians(-10.f + 80.f * dayNightCycleDelta);
+	const float azimuth   = glm::radians(toggle ? 90.f * dayNightCycleDelta 
+											    : 180.f - 90.f * dayNightCycleDelta);
+	sunDirection = glm::vec3(cos(elevation) * cos(azimuth)
+						   , sin(elevation)
+						   , cos(elevation) * sin(azimuth));
+
 	// Setup skybox drawing --------------------------------------
 	glDisable(GL_LIGHTING);
 	glEnable(GL_TEXTURE_2D);
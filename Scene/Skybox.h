@@ -35,6 +35,8 @@ public:
 	void setNight();
 
 	float getDayNightCycleDelta() const;
+	// Unit vector toward the sun, below the horizon at night
+	const glm::vec3& getSunDirection() const;
 	const sf::Image& getTexture(const Face& face, const bool day);
 
 private:
@@ -53,6 +55,7 @@ private:
 	sf::Clock timer;
 	bool toggleDayNight;  // true = day, false = night
 	float dayNightCycleDelta;
+	glm::vec3 sunDirection;
 
 	bool init();
 	void cleanup();
@@ -75,6 +78,11 @@ inline void Skybox::setDay()
 	textures = &dayTextures;
 }
 
+inline const glm::vec3& Skybox::getSunDirection() const
+{
+	return sunDirection;
+}
+
 inline void Skybox::setNight()
 {
 	toggleDayNight = false;
@@ -0,0 +1,176 @@
+/************************************************************************/
+/* TerrainCache
+/* ------------
+/* A versioned binary file holding a finished heightmap's vertex 
+/* arrays and chunk measures, mapped straight back into memory 
+/* on later runs instead of being rebuilt
+/************************************************************************/
+#include "TerrainCache.h"
+#include "../Utility/Logger.h"
+
+#include <glm/glm.hpp>
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+using namespace glm;
+
+
+namespace
+{
+	const char magic[4] = { 'T', 'R', 'N', 'C' };
+
+	const TerrainCache::Key fnvBasis = 14695981039346656037ULL;
+	const TerrainCache::Key fnvPrime = 1099511628211ULL;
+
+	// Arrays start on 16 byte boundaries of the page aligned mapping
+	unsigned int alignUp(const unsigned int offset)
+	{
+		return (offset + 15) & ~15u;
+	}
+}
+
+
+TerrainCache::TerrainCache()
+	: file()
+	, header(nullptr)
+{ }
+
+bool TerrainCache::open( const std::string& filename, const Key key )
+{
+	close();
+	if( !file.open(filename) )
+		return false;
+
+	const Header *h = reinterpret_cast<const Header*>(file.data());
+	const unsigned int numVertices = (file.size() >= sizeof(Header)) ? h->width * h->height : 0;
+
+	std::string problem;
+	if( file.size() < sizeof(Header) || std::memcmp(h->magic, magic, sizeof(magic)) != 0 )
+		problem = "not a terrain cache";
+	else if( h->version != version )
+		problem = "older version";
+	else if( h->key != key )
+		problem = "built from other inputs";
+	else if( h->fileSize != file.size()
+		  || h->measureSize != sizeof(TerrainChunks::Measure)
+		  || h->vertices + numVertices * sizeof(vec3) > file.size()
+		  || h->normals  + numVertices * sizeof(vec3) > file.size()
+		  || h->colors   + numVertices * sizeof(vec4) > file.size()
+		  || h->measures + h->numMeasures * sizeof(TerrainChunks::Measure) > file.size() )
+		problem = "truncated or damaged";
+
+	std::stringstream ss;
+	if( !problem.empty() )
+	{
+		ss << "Ignoring terrain cache " << filename << ": " << problem;
+		Log(ss);
+		file.close();
+		return false;
+	}
+
+	header = h;
+	ss << "Mapped terrain cache " << filename 
+	   << " (" << h->width << "x" << h->height << ")";
+	Log(ss);
+	return true;
+}
+
+void TerrainCache::close()
+{
+	file.close();
+	header = nullptr;
+}
+
+bool TerrainCache::write( const std::string& filename
+						, const Key key
+						, const unsigned int width
+						, const unsigned int height
+						, const vec3 *vertices
+						, const vec3 *normals
+						, const vec4 *colors
+						, const std::vector<TerrainChunks::Measure>& measures )
+{
+	assert(vertices != nullptr && normals != nullptr && colors != nullptr);
+
+	const unsigned int numVertices = width * height;
+
+	Header h;
+	std::memset(&h, 0, sizeof(h));
+	std::memcpy(h.magic, magic, sizeof(magic));
+	h.version     = version;
+	h.key         = key;
+	h.width       = width;
+	h.height      = height;
+	h.numMeasures = measures.size();
+	h.measureSize = sizeof(TerrainChunks::Measure);
+	h.vertices    = alignUp(sizeof(Header));
+	h.normals     = alignUp(h.vertices + numVertices * sizeof(vec3));
+	h.colors      = alignUp(h.normals  + numVertices * sizeof(vec3));
+	h.measures    = alignUp(h.colors   + numVertices * sizeof(vec4));
+	h.fileSize    = h.measures + measures.size() * sizeof(TerrainChunks::Measure);
+
+	std::ofstream out(filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+
+	// Sections are written in offset order, padding up to each one
+	const char padding[16] = { 0 };
+	unsigned int written = 0;
+	auto section = [&](const unsigned int offset, const void *data, const std::size_t size)
+	{
+		out.write(padding, offset - written);
+		out.write(static_cast<const char*>(data), size);
+		written = offset + size;
+	};
+
+	section(0, &h, sizeof(h));
+	section(h.vertices, vertices, numVertices * sizeof(vec3));
+	section(h.normals,  normals,  numVertices * sizeof(vec3));
+	section(h.colors,   colors,   numVertices * sizeof(vec4));
+	if( !measures.empty() )
+		section(h.measures, &measures[0], measures.size() * sizeof(TerrainChunks::Measure));
+	out.close();
+
+	std::stringstream ss;
+	if( !out )
+	{
+		ss << "Warning: unable to write terrain cache " << filename;
+		Log(ss);
+		std::remove(filename.c_str());
+		return false;
+	}
+
+	ss << "Wrote terrain cache " << filename << " (" << h.fileSize << " bytes)";
+	Log(ss);
+	return true;
+}
+
+TerrainCache::Key TerrainCache::hash( const void *data, const std::size_t size )
+{
+	return hash(data, size, fnvBasis);
+}
+
+TerrainCache::Key TerrainCache::hash( const void *data, const std::size_t size, const Key key )
+{
+	const unsigned char *bytes = static_cast<const unsigned char*>(data);
+
+	Key h = key;
+	for(std::size_t i = 0; i < size; ++i)
+	{
+		h ^= bytes[i];
+		h *= fnvPrime;
+	}
+	return h;
+}
+
+bool TerrainCache::hashFile( const std::string& filename, Key& key )
+{
+	MappedFile source;
+	if( !source.open(filename) )
+		return false;
+
+	key = hash(source.data(), source.size());
+	return true;
+}
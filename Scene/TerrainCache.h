@@ -0,0 +1,111 @@
+#pragma once
+/************************************************************************/
+/* TerrainCache
+/* ------------
+/* A versioned binary file holding a finished heightmap's vertex 
+/* arrays and chunk measures, mapped straight back into memory 
+/* on later runs instead of being rebuilt
+/************************************************************************/
+#include "TerrainChunks.h"
+#include "../Utility/MappedFile.h"
+
+#include <glm/glm.hpp>
+
+#include <cassert>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+
+class TerrainCache
+{
+public:
+	// Bump whenever the file layout or the way terrain is built
+	// changes, so files from older builds are rebuilt, not read
+	static const unsigned int version = 1;
+
+	// Fingerprint of everything a cache file was built from
+	typedef unsigned long long Key;
+
+private:
+	struct Header
+	{
+		char magic[4];
+		unsigned int version;
+		Key key;
+		unsigned int width;
+		unsigned int height;
+		unsigned int numMeasures;
+		unsigned int measureSize;   // sizeof(TerrainChunks::Measure)
+		unsigned int vertices;      // byte offsets of each array
+		unsigned int normals;
+		unsigned int colors;
+		unsigned int measures;
+		unsigned int fileSize;
+	};
+
+	MappedFile file;
+	const Header *header;
+
+public:
+	TerrainCache();
+
+	// Map a cache file, false if it is missing, truncated, or 
+	// written by another version or for another key
+	bool open(const std::string& filename, const Key key);
+	void close();
+
+	unsigned int getWidth()       const;
+	unsigned int getHeight()      const;
+	unsigned int getNumMeasures() const;
+
+	// Arrays of getWidth() * getHeight() values, valid while open
+	const glm::vec3* getVertices() const;
+	const glm::vec3* getNormals()  const;
+	const glm::vec4* getColors()   const;
+	const TerrainChunks::Measure* getMeasures() const;
+
+	// Write a cache file for the given key, false on failure
+	static bool write( const std::string& filename
+					 , const Key key
+					 , const unsigned int width
+					 , const unsigned int height
+					 , const glm::vec3 *vertices
+					 , const glm::vec3 *normals
+					 , const glm::vec4 *colors
+					 , const std::vector<TerrainChunks::Measure>& measures );
+
+	// 64-bit FNV-1a of a block of bytes, continuing from key
+	static Key hash(const void *data, const std::size_t size);
+	static Key hash(const void *data, const std::size_t size, const Key key);
+	// Hash the contents of a file, false if it can't be read
+	static bool hashFile(const std::string& filename, Key& key);
+
+private:
+	template<typename T>
+	const T* at(const unsigned int offset) const;
+
+	// Non-copyable
+	TerrainCache(const TerrainCache& other);
+	void operator=(const TerrainCache& other);
+};
+
+
+template<typename T>
+inline const T* TerrainCache::at(const unsigned int offset) const
+{
+	assert(header != nullptr);
+	return reinterpret_cast<const T*>(file.data() + offset);
+}
+
+inline unsigned int TerrainCache::getWidth()       const { return header->width; }
+inline unsigned int TerrainCache::getHeight()      const { return header->height; }
+inline unsigned int TerrainCache::getNumMeasures() const { return header->numMeasures; }
+
+inline const glm::vec3* TerrainCache::getVertices() const { return at<glm::vec3>(header->vertices); }
+inline const glm::vec3* TerrainCache::getNormals()  const { return at<glm::vec3>(header->normals); }
+inline const glm::vec4* TerrainCache::getColors()   const { return at<glm::vec4>(header->colors); }
+inline const TerrainChunks::Measure* TerrainCache::getMeasures() const 
+{
+	return at<TerrainChunks::Measure>(header->measures);
+}
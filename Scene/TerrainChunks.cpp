@@ -0,0 +1,514 @@
+/************************************************************************/
+/* TerrainChunks
+/* -------------
+/* Splits a grid of terrain vertices into square chunks, each drawn
+/* at a level of detail picked by a quadtree from the distance to
+/* the camera and a screen space error bound, skipping chunks that
+/* fall outside the camera frustum
+/************************************************************************/
+#include "../Lib/glee/GLee.h"
+
+#include "TerrainChunks.h"
+#include "../Utility/Logger.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <sstream>
+#include <cmath>
+
+using namespace glm;
+
+
+namespace
+{
+	// Vertex offsets along one side of a chunk at the given step,
+	// the far edge is always included even when size isn't a multiple
+	std::vector<unsigned int> lodPositions( const unsigned int size
+										  , const unsigned int step )
+	{
+		std::vector<unsigned int> positions;
+		for(unsigned int p = 0; p < size; p += step)
+			positions.push_back(p);
+		positions.push_back(size);
+		return positions;
+	}
+
+	// Nearest of the given sorted positions, ties go to the lower one
+	unsigned int snap( const unsigned int p
+					 , const std::vector<unsigned int>& positions )
+	{
+		unsigned int best = positions.front();
+		for each(auto q in positions)
+		{
+			const unsigned int dq = (q > p) ? q - p : p - q;
+			const unsigned int db = (best > p) ? best - p : p - best;
+			if( dq < db )
+				best = q;
+		}
+		return best;
+	}
+}
+
+
+bool TerrainChunks::PatternKey::operator<( const PatternKey& other ) const
+{
+	if( sizeX != other.sizeX ) return sizeX < other.sizeX;
+	if( sizeZ != other.sizeZ ) return sizeZ < other.sizeZ;
+	if( lod   != other.lod   ) return lod   < other.lod;
+	return edges < other.edges;
+}
+
+
+TerrainChunks::TerrainChunks()
+	: vertices(nullptr)
+	, width(0)
+	, height(0)
+	, chunksX(0)
+	, chunksZ(0)
+	, chunks()
+	, nodes()
+	, patterns()
+	, indices()
+{
+	stats.visibleChunks = 0;
+	stats.culledChunks  = 0;
+	stats.nodesTested   = 0;
+	stats.numTriangles  = 0;
+}
+
+void TerrainChunks::build( const vec3 *vertices
+						 , const unsigned int width
+						 , const unsigned int height
+						 , const Measure *measures
+						 , const unsigned int numMeasures )
+{
+	assert(vertices != nullptr);
+	assert(width >= 2 && height >= 2);
+
+	// Patterns index with a row stride of the grid width
+	if( width != this->width )
+		patterns.clear();
+
+	this->vertices = vertices;
+	this->width    = width;
+	this->height   = height;
+
+	chunksX = (width  - 2) / chunkSize + 1;
+	chunksZ = (height - 2) / chunkSize + 1;
+
+	chunks.resize(chunksX * chunksZ);
+	const bool measured = (measures != nullptr && numMeasures == chunks.size());
+	for(unsigned int cz = 0; cz < chunksZ; ++cz)
+	for(unsigned int cx = 0; cx < chunksX; ++cx)
+	{
+		Chunk& chunk = chunks[cz * chunksX + cx];
+		chunk.x     = cx * chunkSize;
+		chunk.z     = cz * chunkSize;
+		chunk.sizeX = std::min(width  - 1 - chunk.x, static_cast<unsigned int>(chunkSize));
+		chunk.sizeZ = std::min(height - 1 - chunk.z, static_cast<unsigned int>(chunkSize));
+		chunk.lod   = 0;
+		chunk.edges   = 0;
+		chunk.visible = true;
+
+		if( measured )
+		{
+			const Measure& measure = measures[cz * chunksX + cx];
+			chunk.minBound = measure.minBound;
+			chunk.maxBound = measure.maxBound;
+			for(unsigned int lod = 0; lod < numLods; ++lod)
+				chunk.error[lod] = measure.error[lod];
+		}
+		else
+			measureChunk(chunk);
+	}
+
+	nodes.clear();
+	buildNode(0, 0, chunksX, chunksZ);
+
+	indices.clear();
+
+	std::stringstream ss;
+	ss << "Built terrain chunks " << chunksX << "x" << chunksZ
+	   << " (" << nodes.size() << " quadtree nodes)";
+	Log(ss);
+}
+
+void TerrainChunks::remeasure( const unsigned int minx, const unsigned int minz
+							 , const unsigned int maxx, const unsigned int maxz )
+{
+	if( chunks.empty() || minx > maxx || minz > maxz )
+		return;
+
+	// Chunks share their edge vertices with their neighbors
+	bool changed = false;
+	for(unsigned int i = 0; i < chunks.size(); ++i)
+	{
+		Chunk& chunk = chunks[i];
+		if( chunk.x > maxx || chunk.x + chunk.sizeX < minx
+		 || chunk.z > maxz || chunk.z + chunk.sizeZ < minz )
+			continue;
+
+		measureChunk(chunk);
+		changed = true;
+	}
+
+	// Node bounds and errors are just the chunks' gathered up,
+	// so rebuilding the tree never touches a vertex
+	if( changed )
+	{
+		nodes.clear();
+		buildNode(0, 0, chunksX, chunksZ);
+	}
+}
+
+void TerrainChunks::getMeasures( std::vector<Measure>& measures ) const
+{
+	measures.resize(chunks.size());
+	for(unsigned int i = 0; i < chunks.size(); ++i)
+	{
+		measures[i].minBound = chunks[i].minBound;
+		measures[i].maxBound = chunks[i].maxBound;
+		for(unsigned int lod = 0; lod < numLods; ++lod)
+			measures[i].error[lod] = chunks[i].error[lod];
+	}
+}
+
+void TerrainChunks::measureChunk( Chunk& chunk ) const
+{
+	chunk.minBound = vec3( 1e30f);
+	chunk.maxBound = vec3(-1e30f);
+	for(unsigned int z = chunk.z; z <= chunk.z + chunk.sizeZ; ++z)
+	for(unsigned int x = chunk.x; x <= chunk.x + chunk.sizeX; ++x)
+	{
+		const vec3& v = vertices[z * width + x];
+		chunk.minBound = min(chunk.minBound, v);
+		chunk.maxBound = max(chunk.maxBound, v);
+	}
+
+	// Error of a level is the largest gap between a full resolution
+	// vertex and the coarse triangles drawn over it
+	for(unsigned int lod = 0; lod < numLods; ++lod)
+	{
+		const std::vector<unsigned int> xs(lodPositions(chunk.sizeX, 1 << lod));
+		const std::vector<unsigned int> zs(lodPositions(chunk.sizeZ, 1 << lod));
+
+		float error = 0.f;
+		for(unsigned int j = 0; j + 1 < zs.size(); ++j)
+		for(unsigned int i = 0; i + 1 < xs.size(); ++i)
+		{
+			const unsigned int x0 = chunk.x + xs[i], x1 = chunk.x + xs[i+1];
+			const unsigned int z0 = chunk.z + zs[j], z1 = chunk.z + zs[j+1];
+
+			const float h00 = vertices[z0 * width + x0].y;
+			const float h10 = vertices[z0 * width + x1].y;
+			const float h01 = vertices[z1 * width + x0].y;
+			const float h11 = vertices[z1 * width + x1].y;
+
+			for(unsigned int z = z0; z <= z1; ++z)
+			for(unsigned int x = x0; x <= x1; ++x)
+			{
+				const float u = static_cast<float>(x - x0) / (x1 - x0);
+				const float v = static_cast<float>(z - z0) / (z1 - z0);
+
+				// Squares are split on the anti-diagonal, like Mesh
+				const float h = (u + v <= 1.f)
+					? h00 + u * (h10 - h00) + v * (h01 - h00)
+					: h11 + (1.f - u) * (h01 - h11) + (1.f - v) * (h10 - h11);
+
+				error = std::max(error, std::abs(vertices[z * width + x].y - h));
+			}
+		}
+
+		// Keep errors increasing so coarser is never judged better
+		chunk.error[lod] = (lod > 0) ? std::max(error, chunk.error[lod - 1]) : error;
+	}
+}
+
+unsigned int TerrainChunks::buildNode( const unsigned int cx0, const unsigned int cz0
+									 , const unsigned int cx1, const unsigned int cz1 )
+{
+	const unsigned int index = nodes.size();
+	nodes.push_back(Node());
+
+	Node node;
+	node.numChildren = 0;
+	node.chunk       = -1;
+
+	if( cx1 - cx0 == 1 && cz1 - cz0 == 1 )
+	{
+		const Chunk& chunk = chunks[cz0 * chunksX + cx0];
+		node.chunk    = cz0 * chunksX + cx0;
+		node.minBound = chunk.minBound;
+		node.maxBound = chunk.maxBound;
+		for(unsigned int lod = 0; lod < numLods; ++lod)
+			node.error[lod] = chunk.error[lod];
+	}
+	else
+	{
+		const unsigned int mx = (cx1 - cx0 > 1) ? (cx0 + cx1) / 2 : cx1;
+		const unsigned int mz = (cz1 - cz0 > 1) ? (cz0 + cz1) / 2 : cz1;
+		const unsigned int rects[4][4] = {
+			{ cx0, cz0, mx,  mz  },
+			{ mx,  cz0, cx1, mz  },
+			{ cx0, mz,  mx,  cz1 },
+			{ mx,  mz,  cx1, cz1 }
+		};
+
+		node.minBound = vec3( 1e30f);
+		node.maxBound = vec3(-1e30f);
+		for(unsigned int lod = 0; lod < numLods; ++lod)
+			node.error[lod] = 0.f;
+
+		for(unsigned int r = 0; r < 4; ++r)
+		{
+			if( rects[r][0] == rects[r][2] || rects[r][1] == rects[r][3] )
+				continue;
+
+			// Recursion can grow nodes, so copy out of it rather than hold a reference
+			const unsigned int child = buildNode(rects[r][0], rects[r][1], rects[r][2], rects[r][3]);
+			const Node childNode = nodes[child];
+
+			node.children[node.numChildren++] = child;
+			node.minBound = min(node.minBound, childNode.minBound);
+			node.maxBound = max(node.maxBound, childNode.maxBound);
+			for(unsigned int lod = 0; lod < numLods; ++lod)
+				node.error[lod] = std::max(node.error[lod], childNode.error[lod]);
+		}
+	}
+
+	nodes[index] = node;
+	return index;
+}
+
+void TerrainChunks::select( const Frustum& frustum
+						  , const vec3& eye
+						  , const float pixelsPerUnit
+						  , const float maxPixelError )
+{
+	if( chunks.empty() )
+		return;
+
+	// Packed (lod, edges, visible) of each chunk, to spot changes
+	std::vector<unsigned int> previous(chunks.size());
+	for(unsigned int i = 0; i < chunks.size(); ++i)
+		previous[i] = (chunks[i].lod << 5) | (chunks[i].edges << 1) | (chunks[i].visible ? 1 : 0);
+
+	stats.nodesTested = 0;
+
+	// error * pixelsPerUnit / distance <= maxPixelError
+	selectNode(0, frustum, true, eye, maxPixelError / pixelsPerUnit);
+	limitLodSteps();
+	stitchEdges();
+
+	bool changed = indices.empty();
+	for(unsigned int i = 0; i < chunks.size() && !changed; ++i)
+		changed = (previous[i] != ((chunks[i].lod << 5) | (chunks[i].edges << 1) | (chunks[i].visible ? 1 : 0)));
+
+	if( changed )
+		buildIndices();
+}
+
+void TerrainChunks::selectNode( const unsigned int index
+							  , const Frustum& frustum
+							  , const bool testFrustum
+							  , const vec3& eye
+							  , const float tolerance )
+{
+	const Node& node = nodes[index];
+
+	// Nearest point of the node's bounds is at least as close as
+	// any chunk below it, so this level is safe for all of them
+	const vec3 nearest(clamp(eye, node.minBound, node.maxBound));
+	const float allowed = tolerance * length(eye - nearest);
+
+	unsigned int lod = numLods - 1;
+	while( lod > 0 && node.error[lod] > allowed )
+		--lod;
+
+	// Once a box is wholly inside, nothing below it needs testing. 
+	// Hidden chunks still get a level so their visible neighbors 
+	// stitch against something sensible.
+	bool testChildren = false;
+	if( testFrustum )
+	{
+		++stats.nodesTested;
+		const Frustum::Result result = frustum.testBox(node.minBound, node.maxBound);
+		if( result == Frustum::outside )
+		{
+			assignLod(index, lod, false);
+			return;
+		}
+		testChildren = (result == Frustum::intersecting);
+	}
+
+	if( node.chunk >= 0 || (lod == numLods - 1 && !testChildren) )
+		assignLod(index, lod, true);
+	else
+	{
+		for(unsigned int i = 0; i < node.numChildren; ++i)
+			selectNode(node.children[i], frustum, testChildren, eye, tolerance);
+	}
+}
+
+void TerrainChunks::assignLod( const unsigned int index
+							 , const unsigned int lod
+							 , const bool visible )
+{
+	const Node& node = nodes[index];
+	if( node.chunk >= 0 )
+	{
+		chunks[node.chunk].lod     = lod;
+		chunks[node.chunk].visible = visible;
+	}
+	else
+	{
+		for(unsigned int i = 0; i < node.numChildren; ++i)
+			assignLod(node.children[i], lod, visible);
+	}
+}
+
+void TerrainChunks::limitLodSteps()
+{
+	// Neighbors may differ by at most one level so that stitching
+	// only ever has to match the next coarser edge
+	bool changed = true;
+	while( changed )
+	{
+		changed = false;
+		for(unsigned int cz = 0; cz < chunksZ; ++cz)
+		for(unsigned int cx = 0; cx < chunksX; ++cx)
+		{
+			Chunk& chunk = chunks[cz * chunksX + cx];
+
+			unsigned int limit = numLods - 1;
+			if( cz > 0 )           limit = std::min(limit, chunks[(cz-1) * chunksX + cx].lod + 1);
+			if( cz + 1 < chunksZ ) limit = std::min(limit, chunks[(cz+1) * chunksX + cx].lod + 1);
+			if( cx > 0 )           limit = std::min(limit, chunks[cz * chunksX + cx - 1].lod + 1);
+			if( cx + 1 < chunksX ) limit = std::min(limit, chunks[cz * chunksX + cx + 1].lod + 1);
+
+			if( chunk.lod > limit )
+			{
+				chunk.lod = limit;
+				changed   = true;
+			}
+		}
+	}
+}
+
+void TerrainChunks::stitchEdges()
+{
+	for(unsigned int cz = 0; cz < chunksZ; ++cz)
+	for(unsigned int cx = 0; cx < chunksX; ++cx)
+	{
+		Chunk& chunk = chunks[cz * chunksX + cx];
+
+		chunk.edges = 0;
+		if( cz > 0           && chunks[(cz-1) * chunksX + cx].lod > chunk.lod ) chunk.edges |= edge_north;
+		if( cz + 1 < chunksZ && chunks[(cz+1) * chunksX + cx].lod > chunk.lod ) chunk.edges |= edge_south;
+		if( cx > 0           && chunks[cz * chunksX + cx - 1].lod > chunk.lod ) chunk.edges |= edge_west;
+		if( cx + 1 < chunksX && chunks[cz * chunksX + cx + 1].lod > chunk.lod ) chunk.edges |= edge_east;
+	}
+}
+
+void TerrainChunks::buildIndices()
+{
+	indices.clear();
+	stats.visibleChunks = 0;
+	stats.culledChunks  = 0;
+	for(unsigned int c = 0; c < chunks.size(); ++c)
+	{
+		const Chunk& chunk = chunks[c];
+		if( !chunk.visible )
+		{
+			++stats.culledChunks;
+			continue;
+		}
+		++stats.visibleChunks;
+
+		const PatternKey key = { chunk.sizeX, chunk.sizeZ, chunk.lod, chunk.edges };
+		const std::vector<unsigned int>& pattern = getPattern(key);
+
+		const unsigned int base = chunk.z * width + chunk.x;
+		for each(auto i in pattern)
+			indices.push_back(base + i);
+	}
+	stats.numTriangles = indices.size() / 3;
+}
+
+const std::vector<unsigned int>& TerrainChunks::getPattern( const PatternKey& key )
+{
+	PatternMap::iterator it = patterns.find(key);
+	if( it != patterns.end() )
+		return it->second;
+
+	const std::vector<unsigned int> xs(lodPositions(key.sizeX, 1 << key.lod));
+	const std::vector<unsigned int> zs(lodPositions(key.sizeZ, 1 << key.lod));
+
+	// Vertices on an edge next to a coarser chunk slide along the edge
+	// onto the coarser chunk's vertices, this collapses the extra
+	// triangles there and leaves no T-junctions along the seam
+	const std::vector<unsigned int> coarseXs(lodPositions(key.sizeX, 2 << key.lod));
+	const std::vector<unsigned int> coarseZs(lodPositions(key.sizeZ, 2 << key.lod));
+
+	std::vector<unsigned int>& pattern = patterns[key];
+	const unsigned int stride = width;
+	auto vertex = [&](unsigned int x, unsigned int z) -> unsigned int
+	{
+		if( (key.edges & edge_north) && z == 0 )         x = snap(x, coarseXs);
+		if( (key.edges & edge_south) && z == key.sizeZ ) x = snap(x, coarseXs);
+		if( (key.edges & edge_west)  && x == 0 )         z = snap(z, coarseZs);
+		if( (key.edges & edge_east)  && x == key.sizeX ) z = snap(z, coarseZs);
+		return z * stride + x;
+	};
+	auto triangle = [&](const unsigned int a, const unsigned int b, const unsigned int c)
+	{
+		if( a == b || b == c || a == c )
+			return;
+		pattern.push_back(a);
+		pattern.push_back(b);
+		pattern.push_back(c);
+	};
+
+	for(unsigned int j = 0; j + 1 < zs.size(); ++j)
+	for(unsigned int i = 0; i + 1 < xs.size(); ++i)
+	{
+		const unsigned int i0 = vertex(xs[i],   zs[j]);
+		const unsigned int i1 = vertex(xs[i],   zs[j+1]);
+		const unsigned int i2 = vertex(xs[i+1], zs[j+1]);
+		const unsigned int i3 = vertex(xs[i+1], zs[j]);
+
+		// Same facing and diagonal as GridIndices::anti_diagonal
+		triangle(i0, i1, i3);
+		triangle(i1, i2, i3);
+	}
+
+	// Patterns are made once per shape and drawn every frame, so they
+	// are worth putting in vertex cache order
+	if( !pattern.empty() )
+	{
+		const unsigned int numVertices = key.sizeZ * stride + key.sizeX + 1;
+		vertexcache::optimizeTriangles(&pattern[0], pattern.size(), numVertices);
+	}
+
+	return pattern;
+}
+
+vertexcache::Stats TerrainChunks::measureVertexCache() const
+{
+	if( indices.empty() )
+	{
+		const vertexcache::Stats none = { 0, 0, 0, 0.f, 0.f };
+		return none;
+	}
+	return vertexcache::measure(&indices[0], indices.size());
+}
+
+void TerrainChunks::draw() const
+{
+	if( indices.empty() )
+		return;
+
+	glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, &indices[0]);
+}
@@ -0,0 +1,171 @@
+#pragma once
+/************************************************************************/
+/* TerrainChunks
+/* -------------
+/* Splits a grid of terrain vertices into square chunks, each drawn
+/* at a level of detail picked by a quadtree from the distance to
+/* the camera and a screen space error bound, skipping chunks that
+/* fall outside the camera frustum
+/************************************************************************/
+#include "../Utility/Frustum.h"
+#include "../Utility/VertexCache.h"
+
+#include <glm/glm.hpp>
+
+#include <map>
+#include <vector>
+
+
+class TerrainChunks
+{
+public:
+	// Grid squares along each side of a full chunk
+	static const unsigned int chunkSize = 32;
+	// Level l draws every (2^l)th vertex of a chunk
+	static const unsigned int numLods   = 6;
+
+	// Chunk edges that are stitched to a coarser neighbor
+	enum Edge
+	{
+		edge_north = 1, // row 0
+		edge_south = 2, // last row
+		edge_west  = 4, // column 0
+		edge_east  = 8  // last column
+	};
+
+	// Counters from the most recent select()
+	struct Stats
+	{
+		unsigned int visibleChunks;
+		unsigned int culledChunks;
+		unsigned int nodesTested;   // quadtree boxes tested against the frustum
+		unsigned int numTriangles;
+	};
+
+	// What build() measures of a chunk's vertices, in chunk order
+	struct Measure
+	{
+		glm::vec3 minBound;
+		glm::vec3 maxBound;
+		float error[numLods];
+	};
+
+private:
+	struct Chunk
+	{
+		unsigned int x, z;          // first vertex column, row
+		unsigned int sizeX, sizeZ;  // grid squares along each side
+		glm::vec3 minBound;
+		glm::vec3 maxBound;
+		float error[numLods];       // max height error of each level
+		unsigned int lod;
+		unsigned int edges;
+		bool visible;
+	};
+
+	struct Node
+	{
+		glm::vec3 minBound;
+		glm::vec3 maxBound;
+		float error[numLods];       // max over the chunks below
+		unsigned int children[4];
+		unsigned int numChildren;
+		int chunk;                  // chunk index for leaves, else -1
+	};
+
+	// Index patterns are shared by every chunk of the same shape
+	struct PatternKey
+	{
+		unsigned int sizeX, sizeZ;
+		unsigned int lod;
+		unsigned int edges;
+
+		bool operator<(const PatternKey& other) const;
+	};
+	typedef std::map<PatternKey, std::vector<unsigned int> > PatternMap;
+
+	const glm::vec3 *vertices;
+	unsigned int width;
+	unsigned int height;
+	unsigned int chunksX;
+	unsigned int chunksZ;
+
+	std::vector<Chunk> chunks;
+	std::vector<Node>  nodes;
+	PatternMap         patterns;
+
+	// Selected chunks' patterns offset into the full vertex grid
+	std::vector<unsigned int> indices;
+
+	Stats stats;
+
+public:
+	TerrainChunks();
+
+	// Lay out chunks over a row-major grid of vertices and measure
+	// the error of each level, or take numMeasures previously saved 
+	// measures if they cover every chunk
+	void build( const glm::vec3 *vertices
+			  , const unsigned int width
+			  , const unsigned int height
+			  , const Measure *measures = nullptr
+			  , const unsigned int numMeasures = 0 );
+
+	// Measure again only the chunks touching an inclusive rectangle
+	// of vertices whose heights changed
+	void remeasure( const unsigned int minx, const unsigned int minz
+				  , const unsigned int maxx, const unsigned int maxz );
+
+	// Copy out every chunk's measure, to be passed back to build()
+	void getMeasures(std::vector<Measure>& measures) const;
+
+	// Pick a level for every chunk so that no chunk's error covers more
+	// than maxPixelError pixels, where pixelsPerUnit is the size in
+	// pixels of one world unit seen from unit distance, and hide the
+	// chunks whose bounds are outside the frustum.
+	// Touches no OpenGL state, so it can run without a window.
+	void select( const Frustum& frustum
+			   , const glm::vec3& eye
+			   , const float pixelsPerUnit
+			   , const float maxPixelError );
+
+	// Draw the selected chunks from the currently bound vertex arrays
+	void draw() const;
+
+	// Replay the selected chunks' indices through a simulated vertex
+	// cache, this walks every index so it's for reporting only
+	vertexcache::Stats measureVertexCache() const;
+
+	bool         isBuilt()         const;
+	unsigned int getNumChunks()    const;
+	unsigned int getNumTriangles() const;
+	unsigned int getLod(const unsigned int chunk) const;
+	bool         isVisible(const unsigned int chunk) const;
+	const Stats& getStats() const;
+
+private:
+	unsigned int buildNode( const unsigned int cx0, const unsigned int cz0
+						  , const unsigned int cx1, const unsigned int cz1 );
+	void measureChunk(Chunk& chunk) const;
+
+	void selectNode( const unsigned int node
+				   , const Frustum& frustum
+				   , const bool testFrustum
+				   , const glm::vec3& eye
+				   , const float tolerance );
+	void assignLod( const unsigned int node
+				  , const unsigned int lod
+				  , const bool visible );
+	void limitLodSteps();
+	void stitchEdges();
+	void buildIndices();
+
+	const std::vector<unsigned int>& getPattern(const PatternKey& key);
+};
+
+inline bool         TerrainChunks::isBuilt()         const { return !chunks.empty(); }
+inline unsigned int TerrainChunks::getNumChunks()    const { return chunks.size(); }
+inline unsigned int TerrainChunks::getNumTriangles() const { return indices.size() / 3; }
+inline unsigned int TerrainChunks::getLod(const unsigned int chunk) const { return chunks[chunk].lod; }
+inline bool TerrainChunks::isVisible(const unsigned int chunk) const { return chunks[chunk].visible; }
+inline const TerrainChunks::Stats& TerrainChunks::getStats() const { return stats; }
@@ -0,0 +1,240 @@
+/************************************************************************/
+/* TerrainGen
+/* ----------
+/* Seeded, tileable height field synthesis
+/************************************************************************/
+#include "TerrainGen.h"
+#include "../Utility/HeightGrid.h"
+#include "../Utility/Parallel.h"
+#include "../Utility/Logger.h"
+
+#include <algorithm>
+#include <sstream>
+#include <vector>
+#include <cmath>
+
+
+namespace
+{
+	// Integer hash of a world grid position, mixes well enough 
+	// that neighboring positions look unrelated
+	unsigned int hash( const int x, const int z, const unsigned int seed )
+	{
+		unsigned int h = seed * 0x9e3779b9u;
+		h ^= static_cast<unsigned int>(x) * 0x85ebca6bu;
+		h ^= static_cast<unsigned int>(z) * 0xc2b2ae35u;
+		h ^= h >> 16; h *= 0x7feb352du;
+		h ^= h >> 15; h *= 0x846ca68bu;
+		h ^= h >> 16;
+		return h;
+	}
+
+	// Hash mapped to [-1,1)
+	float signedRand( const int x, const int z, const unsigned int seed )
+	{
+		return (hash(x, z, seed) >> 8) * (2.f / 16777216.f) - 1.f;
+	}
+
+	// Rows of work per worker large enough to be worth a thread
+	unsigned int rowGrain( const unsigned int samplesPerRow )
+	{
+		return std::max(1u, 16384u / std::max(1u, samplesPerRow));
+	}
+
+	// Hashed unit gradient at a lattice point of the noise
+	void gradient( const int cx, const int cz, const unsigned int seed
+				 , float& gx, float& gz )
+	{
+		static const float dirX[8] = { 1.f, -1.f, 0.f,  0.f, 0.7071f, -0.7071f,  0.7071f, -0.7071f };
+		static const float dirZ[8] = { 0.f,  0.f, 1.f, -1.f, 0.7071f,  0.7071f, -0.7071f, -0.7071f };
+		const unsigned int g = hash(cx, cz, seed) >> 29;
+		gx = dirX[g];
+		gz = dirZ[g];
+	}
+
+	// Quintic fade keeps the surface's slope continuous across cells
+	float fade( const float t )
+	{
+		return t * t * t * (t * (t * 6.f - 15.f) + 10.f);
+	}
+
+	// Add one octave of 2d gradient noise (in about [-1,1]) to a row of 
+	// samples. The lattice gradients along the row's two bounding lattice 
+	// rows are hashed once up front, the per sample loop is then only
+	// table lookups and arithmetic.
+	void addNoiseRow( float *row
+					, const unsigned int width
+					, const int originX
+					, const float z
+					, const float frequency
+					, const float amplitude
+					, const unsigned int seed
+					, std::vector<float>& scratch )
+	{
+		const float fz  = z * frequency;
+		const float fz0 = std::floor(fz);
+		const int   iz  = static_cast<int>(fz0);
+		const float tz  = fz - fz0;
+		const float uz  = fade(tz);
+
+		const int first = static_cast<int>(std::floor(originX * frequency));
+		const int last  = static_cast<int>(std::floor((originX + static_cast<int>(width) - 1) * frequency)) + 1;
+		const unsigned int count = last - first + 1;
+
+		// (gx, gz) for the lower lattice row, then for the upper one
+		scratch.resize(4 * count);
+		float *g0 = &scratch[0];
+		float *g1 = &scratch[2 * count];
+		for(unsigned int i = 0; i < count; ++i)
+		{
+			gradient(first + i, iz,     seed, g0[2*i], g0[2*i+1]);
+			gradient(first + i, iz + 1, seed, g1[2*i], g1[2*i+1]);
+		}
+
+		for(unsigned int x = 0; x < width; ++x)
+		{
+			// Truncate and fix up negatives, cheaper than std::floor here
+			const float fx = (originX + static_cast<int>(x)) * frequency;
+			int ix = static_cast<int>(fx);
+			if( fx < ix ) --ix;
+			const unsigned int i = ix - first;
+			const float tx = fx - ix;
+			const float ux  = fade(tx);
+
+			const float n00 = g0[2*i]     * tx         + g0[2*i+1]     * tz;
+			const float n10 = g0[2*i + 2] * (tx - 1.f) + g0[2*i + 3]   * tz;
+			const float n01 = g1[2*i]     * tx         + g1[2*i+1]     * (tz - 1.f);
+			const float n11 = g1[2*i + 2] * (tx - 1.f) + g1[2*i + 3]   * (tz - 1.f);
+
+			const float nx0 = n00 + ux * (n10 - n00);
+			const float nx1 = n01 + ux * (n11 - n01);
+			row[x] += amplitude * 1.4142f * (nx0 + uz * (nx1 - nx0));
+		}
+	}
+}
+
+
+bool terraingen::isPowerOfTwoPlusOne( const unsigned int size )
+{
+	return size >= 3 && ((size - 1) & (size - 2)) == 0;
+}
+
+bool terraingen::diamondSquare( HeightGrid& grid
+							  , const unsigned int seed
+							  , const int originX
+							  , const int originZ
+							  , const float range
+							  , const float roughness )
+{
+	const unsigned int size = grid.getWidth();
+	if( size != grid.getHeight() || !isPowerOfTwoPlusOne(size) )
+	{
+		std::stringstream ss;
+		ss << "Warning: diamond-square needs a square 2^n+1 grid, not "
+		   << grid.getWidth() << "x" << grid.getHeight();
+		Log(ss);
+		return false;
+	}
+
+	float *h = grid.data();
+	const int n = static_cast<int>(size);
+
+	// Corners are set straight from the hash
+	const int last = n - 1;
+	h[0]               = range * signedRand(originX,        originZ,        seed);
+	h[last]            = range * signedRand(originX + last, originZ,        seed);
+	h[last * n]        = range * signedRand(originX,        originZ + last, seed);
+	h[last * n + last] = range * signedRand(originX + last, originZ + last, seed);
+
+	float levelRange = range;
+	for(int side = last; side >= 2; side /= 2, levelRange *= roughness)
+	{
+		const int half  = side / 2;
+		const int cells = last / side;
+		const float r   = levelRange;
+
+		// Square step: the center of each square from its corners.
+		// Every center is independent, so rows of squares run in parallel.
+		auto squares = [=](const unsigned int begin, const unsigned int end)
+		{
+			for(int cz = begin; cz < static_cast<int>(end); ++cz)
+			for(int cx = 0; cx < cells; ++cx)
+			{
+				const int x = cx * side;
+				const int z = cz * side;
+				const float avg = 0.25f * ( h[z * n + x]          + h[z * n + x + side]
+										  + h[(z + side) * n + x] + h[(z + side) * n + x + side] );
+				h[(z + half) * n + x + half] = avg + r * signedRand(originX + x + half, originZ + z + half, seed);
+			}
+		};
+		parallel::forRange(0, cells, squares, rowGrain(cells));
+
+		// Diamond step: edge midpoints from the samples around them. 
+		// Rows alternate between midpoints of horizontal and vertical edges.
+		auto diamonds = [=](const unsigned int begin, const unsigned int end)
+		{
+			for(int row = begin; row < static_cast<int>(end); ++row)
+			{
+				const int z = row * half;
+				for(int x = (row % 2 == 0) ? half : 0; x < n; x += side)
+				{
+					float avg;
+					if( z == 0 || z == last )
+						avg = 0.5f * (h[z * n + x - half] + h[z * n + x + half]);
+					else if( x == 0 || x == last )
+						avg = 0.5f * (h[(z - half) * n + x] + h[(z + half) * n + x]);
+					else
+						avg = 0.25f * ( h[z * n + x - half] + h[z * n + x + half]
+									  + h[(z - half) * n + x] + h[(z + half) * n + x] );
+
+					h[z * n + x] = avg + r * signedRand(originX + x, originZ + z, seed);
+				}
+			}
+		};
+		parallel::forRange(0, last / half + 1, diamonds, rowGrain(cells + 1));
+	}
+
+	return true;
+}
+
+void terraingen::fbm( HeightGrid& grid
+					, const unsigned int seed
+					, const int originX
+					, const int originZ
+					, const float frequency
+					, const unsigned int octaves
+					, const float lacunarity
+					, const float gain )
+{
+	const unsigned int width = grid.getWidth();
+
+	// Per octave constants, shared by every row
+	std::vector<float> frequencies(octaves), amplitudes(octaves);
+	float f = frequency, a = 1.f;
+	for(unsigned int o = 0; o < octaves; ++o, f *= lacunarity, a *= gain)
+	{
+		frequencies[o] = f;
+		amplitudes[o]  = a;
+	}
+	const float *freqs = octaves ? &frequencies[0] : nullptr;
+	const float *amps  = octaves ? &amplitudes[0]  : nullptr;
+
+	// Rows are independent, octaves are summed a whole row at a time
+	auto rows = [&](const unsigned int begin, const unsigned int end)
+	{
+		std::vector<float> scratch;
+		for(unsigned int z = begin; z < end; ++z)
+		{
+			float *row = grid.row(z);
+			std::fill(row, row + width, 0.f);
+
+			const float wz = static_cast<float>(originZ + static_cast<int>(z));
+			for(unsigned int o = 0; o < octaves; ++o)
+			{
+				const unsigned int octaveSeed = seed + 0x632be5abu * (o + 1);
+				addNoiseRow(row, width, originX, wz, freqs[o], amps[o], octaveSeed, scratch);
+			}
+		}
+	};
+	parallel::forRange(0, grid.getHeight(), rows, rowGrain(width * std::max(1u, octaves)));
+}
@@ -0,0 +1,57 @@
+#pragma once
+/************************************************************************/
+/* TerrainGen
+/* ----------
+/* Seeded, tileable height field synthesis
+/************************************************************************/
+class HeightGrid;
+
+
+namespace terraingen
+{
+	// Is size of the form 2^n + 1, as diamond-square needs?
+	bool isPowerOfTwoPlusOne(const unsigned int size);
+
+	/**
+	 * Fill a square grid using the diamond-square algorithm
+	 * \param grid      - a square grid of 2^n + 1 samples per side
+	 * \param seed      - picks the terrain, same seed same terrain
+	 * \param originX   - grid column of the first sample in the world
+	 * \param originZ   - grid row of the first sample in the world
+	 * \param range     - largest random offset, at the coarsest level
+	 * \param roughness - range multiplier from one level to the next
+	 * \return - false if the grid size isn't supported
+	 *
+	 * Offsets are hashed from the seed and each sample's world position, 
+	 * and samples on the grid border only average along their edge, 
+	 * so equal sized tiles generated on their own match where they meet.
+	**/
+	bool diamondSquare( HeightGrid& grid
+					  , const unsigned int seed
+					  , const int originX
+					  , const int originZ
+					  , const float range     = 1.f
+					  , const float roughness = 0.5f );
+
+	/**
+	 * Fill a grid of any size with fractal sums of gradient noise
+	 * \param grid       - the grid to fill
+	 * \param seed       - picks the terrain, same seed same terrain
+	 * \param originX    - grid column of the first sample in the world
+	 * \param originZ    - grid row of the first sample in the world
+	 * \param frequency  - cycles per sample of the first octave
+	 * \param octaves    - number of noise layers summed
+	 * \param lacunarity - frequency multiplier between octaves
+	 * \param gain       - amplitude multiplier between octaves
+	 *
+	 * Noise is evaluated at world positions, so tiles always match.
+	**/
+	void fbm( HeightGrid& grid
+			, const unsigned int seed
+			, const int originX
+			, const int originZ
+			, const float frequency    = 1.f / 128.f
+			, const unsigned int octaves = 6
+			, const float lacunarity   = 2.f
+			, const float gain         = 0.5f );
+};
@@ -0,0 +1,457 @@
+/************************************************************************/
+/* TerrainStreamer
+/* ---------------
+/* Pages square tiles of a world's heights in and out of memory 
+/* around a point of interest. Tiles are read from a tiled height 
+/* file and decoded on a background thread, and the least recently 
+/* used ones are dropped to stay within a memory budget.
+/************************************************************************/
+#include "TerrainStreamer.h"
+#include "../Utility/Logger.h"
+
+#include <SFML/System/Lock.hpp>
+#include <SFML/System/Sleep.hpp>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <sstream>
+
+using namespace glm;
+
+
+namespace
+{
+	const char magic[4] = { 'T', 'I', 'L', 'E' };
+
+	// Heights are stored as 16 bit steps between the file's min and max
+	const float maxCode = 65535.f;
+
+	const std::size_t defaultBudget = 64 * 1024 * 1024;
+}
+
+
+TerrainStreamer::TerrainStreamer()
+	: filename("")
+	, offsets()
+	, tiles()
+	, lastUsed()
+	, inFlight()
+	, numResident(0)
+	, numInFlight(0)
+	, frame(0)
+	, budget(defaultBudget)
+	, mutex()
+	, requests()
+	, loaded()
+	, stopping(false)
+	, loader(nullptr)
+{
+	std::memset(&header, 0, sizeof(header));
+}
+
+TerrainStreamer::~TerrainStreamer()
+{
+	close();
+}
+
+bool TerrainStreamer::open( const std::string& filename )
+{
+	close();
+
+	std::ifstream in(filename.c_str(), std::ios::in | std::ios::binary);
+	in.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+	std::stringstream ss;
+	if( !in || std::memcmp(header.magic, magic, sizeof(magic)) != 0 
+	 || header.version != version || header.tileSize < 2
+	 || header.tilesX == 0 || header.tilesZ == 0 || header.groundScale <= 0.f )
+	{
+		ss << "Warning: unable to open terrain tiles " << filename;
+		Log(ss);
+		std::memset(&header, 0, sizeof(header));
+		return false;
+	}
+
+	const unsigned int numTiles = header.tilesX * header.tilesZ;
+	offsets.resize(numTiles);
+	in.read(reinterpret_cast<char*>(&offsets[0]), numTiles * sizeof(unsigned long long));
+	if( !in )
+	{
+		ss << "Warning: terrain tiles " << filename << " are truncated";
+		Log(ss);
+		offsets.clear();
+		std::memset(&header, 0, sizeof(header));
+		return false;
+	}
+
+	this->filename = filename;
+	tiles.assign(numTiles, nullptr);
+	lastUsed.assign(numTiles, 0);
+	inFlight.assign(numTiles, false);
+	numResident = 0;
+	numInFlight = 0;
+	frame       = 0;
+	stopping    = false;
+
+	loader = new sf::Thread(&TerrainStreamer::runLoader, this);
+	loader->Launch();
+
+	ss << "Opened terrain tiles " << filename << ": "
+	   << header.tilesX << "x" << header.tilesZ << " tiles of " 
+	   << header.tileSize << "x" << header.tileSize << " vertices";
+	Log(ss);
+	return true;
+}
+
+void TerrainStreamer::close()
+{
+	if( loader != nullptr )
+	{
+		{
+			sf::Lock lock(mutex);
+			stopping = true;
+		}
+		loader->Wait();
+		delete loader;
+		loader = nullptr;
+	}
+
+	for each(auto tile in tiles)
+		delete tile;
+	for each(auto tile in loaded)
+		delete tile.second;
+
+	tiles.clear();
+	lastUsed.clear();
+	inFlight.clear();
+	requests.clear();
+	loaded.clear();
+	offsets.clear();
+	numResident = 0;
+	numInFlight = 0;
+}
+
+void TerrainStreamer::setMemoryBudget( const std::size_t bytes )
+{
+	budget = bytes;
+	evict(maxResident());
+}
+
+void TerrainStreamer::update( const vec3& position, const float radius )
+{
+	if( !isOpen() )
+		return;
+
+	++frame;
+	takeLoaded();
+
+	// Tiles whose square comes within radius of the position
+	const float extent = getTileExtent();
+	const int tx0 = std::max(0, static_cast<int>(std::floor((position.x - radius) / extent)));
+	const int tz0 = std::max(0, static_cast<int>(std::floor((position.z - radius) / extent)));
+	const int tx1 = std::min(static_cast<int>(header.tilesX) - 1, static_cast<int>(std::floor((position.x + radius) / extent)));
+	const int tz1 = std::min(static_cast<int>(header.tilesZ) - 1, static_cast<int>(std::floor((position.z + radius) / extent)));
+
+	std::vector<std::pair<float, unsigned int> > wanted;
+	for(int tz = tz0; tz <= tz1; ++tz)
+	for(int tx = tx0; tx <= tx1; ++tx)
+	{
+		const float dx = std::max(0.f, std::max(tx * extent - position.x, position.x - (tx + 1) * extent));
+		const float dz = std::max(0.f, std::max(tz * extent - position.z, position.z - (tz + 1) * extent));
+		const float d2 = dx * dx + dz * dz;
+		if( d2 <= radius * radius )
+			wanted.push_back(std::make_pair(d2, tz * header.tilesX + tx));
+	}
+
+	// Nearest first, and never more than fit in the budget
+	std::sort(wanted.begin(), wanted.end());
+	const unsigned int maxTiles = maxResident();
+	if( wanted.size() > maxTiles )
+		wanted.resize(maxTiles);
+
+	for each(const auto& tile in wanted)
+	{
+		if( tiles[tile.second] != nullptr )
+			lastUsed[tile.second] = frame;
+	}
+
+	// Replace the queue, requests the loader hasn't started are dropped
+	{
+		sf::Lock lock(mutex);
+		for each(auto index in requests)
+		{
+			inFlight[index] = false;
+			--numInFlight;
+		}
+		requests.clear();
+
+		for each(const auto& tile in wanted)
+		{
+			const unsigned int index = tile.second;
+			if( tiles[index] == nullptr && !inFlight[index] )
+			{
+				requests.push_back(index);
+				inFlight[index] = true;
+				++numInFlight;
+			}
+		}
+	}
+
+	evict(maxTiles);
+}
+
+void TerrainStreamer::flush()
+{
+	if( !isOpen() )
+		return;
+
+	for(;;)
+	{
+		takeLoaded();
+		if( numInFlight == 0 )
+			break;
+		sf::Sleep(0.001f);
+	}
+	evict(maxResident());
+}
+
+float TerrainStreamer::heightAt( const float x, const float z ) const
+{
+	const float offMap = std::numeric_limits<float>::min();
+	if( !isOpen() )
+		return offMap;
+
+	const unsigned int span = header.tileSize - 1;
+	const float gx = x / header.groundScale;
+	const float gz = z / header.groundScale;
+	if( !(gx >= 0.f && gz >= 0.f 
+	   && gx < static_cast<float>(header.tilesX * span)
+	   && gz < static_cast<float>(header.tilesZ * span)) )
+		return offMap;
+
+	// Tiles share their edge vertices, so one tile always has all
+	// four corners of the square around the point
+	const unsigned int tx = std::min(static_cast<unsigned int>(gx) / span, header.tilesX - 1);
+	const unsigned int tz = std::min(static_cast<unsigned int>(gz) / span, header.tilesZ - 1);
+	const unsigned int index = tz * header.tilesX + tx;
+	const HeightGrid *tile = tiles[index];
+	if( tile == nullptr )
+		return offMap;
+	lastUsed[index] = frame;
+
+	const float lx = gx - tx * span;
+	const float lz = gz - tz * span;
+	const unsigned int x0 = std::min(static_cast<unsigned int>(lx), span - 1);
+	const unsigned int z0 = std::min(static_cast<unsigned int>(lz), span - 1);
+	const float dx = lx - x0;
+	const float dz = lz - z0;
+
+	const float *row0 = tile->row(z0);
+	const float *row1 = tile->row(z0 + 1);
+	const float h1 = row0[x0]     + dz * (row1[x0]     - row0[x0]);
+	const float h2 = row0[x0 + 1] + dz * (row1[x0 + 1] - row0[x0 + 1]);
+	return h1 + dx * (h2 - h1);
+}
+
+void TerrainStreamer::heightsAt( const vec2 *points
+							   , const unsigned int count
+							   , float *heights ) const
+{
+	for(unsigned int i = 0; i < count; ++i)
+		heights[i] = heightAt(points[i].x, points[i].y);
+}
+
+bool TerrainStreamer::isResident( const unsigned int tileX, const unsigned int tileZ ) const
+{
+	return tileX < header.tilesX && tileZ < header.tilesZ 
+		&& tiles[tileZ * header.tilesX + tileX] != nullptr;
+}
+
+bool TerrainStreamer::write( const std::string& filename
+						   , const unsigned int tileSize
+						   , const unsigned int tilesX
+						   , const unsigned int tilesZ
+						   , const float groundScale
+						   , const float minHeight
+						   , const float maxHeight
+						   , const TileSource& source )
+{
+	std::stringstream ss;
+	if( tileSize < 2 || tilesX == 0 || tilesZ == 0 || groundScale <= 0.f || !(maxHeight > minHeight) )
+	{
+		ss << "Warning: bad parameters for terrain tiles " << filename;
+		Log(ss);
+		return false;
+	}
+
+	Header h;
+	std::memset(&h, 0, sizeof(h));
+	std::memcpy(h.magic, magic, sizeof(magic));
+	h.version     = version;
+	h.tileSize    = tileSize;
+	h.tilesX      = tilesX;
+	h.tilesZ      = tilesZ;
+	h.groundScale = groundScale;
+	h.minHeight   = minHeight;
+	h.maxHeight   = maxHeight;
+
+	// Tiles follow the offset table in row-major order
+	const unsigned int numTiles = tilesX * tilesZ;
+	const unsigned int count    = tileSize * tileSize;
+	std::vector<unsigned long long> table(numTiles);
+	for(unsigned int i = 0; i < numTiles; ++i)
+		table[i] = sizeof(Header) + numTiles * sizeof(unsigned long long) 
+				 + static_cast<unsigned long long>(i) * count * sizeof(unsigned short);
+
+	std::ofstream out(filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+	out.write(reinterpret_cast<const char*>(&table[0]), numTiles * sizeof(unsigned long long));
+
+	// One shared range keeps the codes of shared edges identical
+	const float scale = maxCode / (maxHeight - minHeight);
+	HeightGrid grid(tileSize, tileSize);
+	std::vector<unsigned short> codes(count);
+	for(unsigned int tz = 0; tz < tilesZ && out; ++tz)
+	for(unsigned int tx = 0; tx < tilesX && out; ++tx)
+	{
+		source(tx, tz, grid);
+
+		const float *heights = grid.data();
+		for(unsigned int i = 0; i < count; ++i)
+		{
+			const float height = std::min(std::max(heights[i], minHeight), maxHeight);
+			codes[i] = static_cast<unsigned short>((height - minHeight) * scale + 0.5f);
+		}
+		out.write(reinterpret_cast<const char*>(&codes[0]), count * sizeof(unsigned short));
+	}
+	out.close();
+
+	if( !out )
+	{
+		ss << "Warning: unable to write terrain tiles " << filename;
+		Log(ss);
+		return false;
+	}
+
+	ss << "Wrote terrain tiles " << filename << ": " << tilesX << "x" << tilesZ 
+	   << " tiles of " << tileSize << "x" << tileSize << " vertices";
+	Log(ss);
+	return true;
+}
+
+void TerrainStreamer::runLoader( void *userData )
+{
+	static_cast<TerrainStreamer*>(userData)->loaderLoop();
+}
+
+void TerrainStreamer::loaderLoop()
+{
+	// Only the header, offsets and filename are shared without the 
+	// mutex, and they don't change until close() has joined this thread
+	std::ifstream in(filename.c_str(), std::ios::in | std::ios::binary);
+
+	const unsigned int count = header.tileSize * header.tileSize;
+	const float step = (header.maxHeight - header.minHeight) / maxCode;
+	std::vector<unsigned short> codes(count);
+
+	for(;;)
+	{
+		unsigned int index = 0;
+		bool haveRequest = false;
+		{
+			sf::Lock lock(mutex);
+			if( stopping )
+				return;
+			if( !requests.empty() )
+			{
+				index = requests.front();
+				requests.pop_front();
+				haveRequest = true;
+			}
+		}
+
+		if( !haveRequest )
+		{
+			sf::Sleep(0.002f);
+			continue;
+		}
+
+		// A tile that can't be read comes back flat at the lowest height
+		HeightGrid *grid = new HeightGrid(header.tileSize, header.tileSize, header.minHeight);
+		in.clear();
+		in.seekg(static_cast<std::streamoff>(offsets[index]));
+		in.read(reinterpret_cast<char*>(&codes[0]), count * sizeof(unsigned short));
+		if( in )
+		{
+			float *heights = grid->data();
+			for(unsigned int i = 0; i < count; ++i)
+				heights[i] = header.minHeight + codes[i] * step;
+		}
+
+		sf::Lock lock(mutex);
+		loaded.push_back(LoadedTile(index, grid));
+	}
+}
+
+bool TerrainStreamer::takeLoaded()
+{
+	std::vector<LoadedTile> ready;
+	{
+		sf::Lock lock(mutex);
+		ready.swap(loaded);
+	}
+
+	for each(const auto& tile in ready)
+	{
+		const unsigned int index = tile.first;
+		assert(inFlight[index] && tiles[index] == nullptr);
+		inFlight[index] = false;
+		--numInFlight;
+
+		tiles[index]    = tile.second;
+		lastUsed[index] = frame;
+		++numResident;
+	}
+
+	return !ready.empty();
+}
+
+void TerrainStreamer::evict( const unsigned int maxTiles )
+{
+	// Tiles used this frame stay, even over budget
+	while( numResident + numInFlight > maxTiles )
+	{
+		int oldest = -1;
+		for(unsigned int i = 0; i < tiles.size(); ++i)
+		{
+			if( tiles[i] != nullptr && lastUsed[i] != frame 
+			 && (oldest < 0 || lastUsed[i] < lastUsed[oldest]) )
+				oldest = i;
+		}
+		if( oldest < 0 )
+			break;
+
+		delete tiles[oldest];
+		tiles[oldest] = nullptr;
+		--numResident;
+	}
+}
+
+std::size_t TerrainStreamer::tileBytes() const
+{
+	return header.tileSize * header.tileSize * sizeof(float);
+}
+
+unsigned int TerrainStreamer::maxResident() const
+{
+	const std::size_t bytes = tileBytes();
+	if( bytes == 0 )
+		return 1;
+	return std::max<unsigned int>(1, static_cast<unsigned int>(budget / bytes));
+}
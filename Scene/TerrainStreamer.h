@@ -0,0 +1,147 @@
+#pragma once
+/************************************************************************/
+/* TerrainStreamer
+/* ---------------
+/* Pages square tiles of a world's heights in and out of memory 
+/* around a point of interest. Tiles are read from a tiled height 
+/* file and decoded on a background thread, and the least recently 
+/* used ones are dropped to stay within a memory budget.
+/************************************************************************/
+#include "../Utility/HeightGrid.h"
+
+#include <SFML/System/Mutex.hpp>
+#include <SFML/System/Thread.hpp>
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+class TerrainStreamer
+{
+public:
+	static const unsigned int version = 1;
+
+	// Fills a tileSize x tileSize grid with the heights of tile (x, z)
+	typedef std::function<void (unsigned int, unsigned int, HeightGrid&)> TileSource;
+
+private:
+	struct Header
+	{
+		char magic[4];
+		unsigned int version;
+		unsigned int tileSize;     // vertices along a side, edges are shared
+		unsigned int tilesX;
+		unsigned int tilesZ;
+		float groundScale;
+		float minHeight;           // range heights are quantized over
+		float maxHeight;
+	};
+
+	// Finished by the loader, waiting for update() to take them in
+	typedef std::pair<unsigned int, HeightGrid*> LoadedTile;
+
+	std::string filename;
+	Header header;
+	std::vector<unsigned long long> offsets;   // file offset of each tile
+
+	std::vector<HeightGrid*> tiles;      // resident tiles, else null
+	mutable std::vector<unsigned int> lastUsed;   // frame of the last update or query using each
+	std::vector<bool> inFlight;          // requested and not yet taken in
+	unsigned int numResident;
+	unsigned int numInFlight;
+	mutable unsigned int frame;
+	std::size_t budget;                  // in bytes
+
+	// Shared with the loader thread, guarded by mutex
+	sf::Mutex mutex;
+	std::deque<unsigned int> requests;   // nearest first
+	std::vector<LoadedTile>  loaded;
+	bool stopping;
+
+	sf::Thread *loader;
+
+public:
+	TerrainStreamer();
+	~TerrainStreamer();
+
+	// Open a tiled height file and start the loader thread
+	bool open(const std::string& filename);
+	// Stop the loader and drop every tile
+	void close();
+
+	// Bytes of height data to keep resident, at least one tile
+	void setMemoryBudget(const std::size_t bytes);
+
+	// Take in tiles loaded since the last call, then request the 
+	// tiles within radius of position, nearest first, as many as 
+	// the budget holds, and evict the least recently used others
+	void update(const glm::vec3& position, const float radius);
+
+	// Wait until every requested tile is resident
+	void flush();
+
+	/**
+	 * Get the height at a world position, interpolated the same
+	 * way as HeightMap::heightAt(), across tile borders
+	 * \return - the height, or the smallest possible float if the
+	 *           position is off the world or its tile isn't resident
+	**/
+	float heightAt(const float x, const float z) const;
+	void  heightsAt(const glm::vec2 *points
+				  , const unsigned int count
+				  , float *heights) const;
+
+	bool isResident(const unsigned int tileX, const unsigned int tileZ) const;
+
+	bool         isOpen()         const;
+	unsigned int getTileSize()    const;
+	unsigned int getTilesX()      const;
+	unsigned int getTilesZ()      const;
+	float        getGroundScale() const;
+	float        getTileExtent()  const;   // world units along a tile side
+	unsigned int getNumResident() const;
+	std::size_t  getMemoryUsed()  const;
+
+	// Write a tiled height file of tilesX x tilesZ tiles, each
+	// sampled by source with heights clamped to [minHeight, maxHeight].
+	// Neighboring tiles should agree on the edge they share.
+	static bool write( const std::string& filename
+					 , const unsigned int tileSize
+					 , const unsigned int tilesX
+					 , const unsigned int tilesZ
+					 , const float groundScale
+					 , const float minHeight
+					 , const float maxHeight
+					 , const TileSource& source );
+
+private:
+	static void runLoader(void *userData);
+	void loaderLoop();
+
+	// Move finished tiles into place, false if none were waiting
+	bool takeLoaded();
+	void evict(const unsigned int maxTiles);
+
+	std::size_t tileBytes() const;
+	unsigned int maxResident() const;
+
+	// Non-copyable
+	TerrainStreamer(const TerrainStreamer& other);
+	void operator=(const TerrainStreamer& other);
+};
+
+
+inline bool         TerrainStreamer::isOpen()         const { return loader != nullptr; }
+inline unsigned int TerrainStreamer::getTileSize()    const { return header.tileSize; }
+inline unsigned int TerrainStreamer::getTilesX()      const { return header.tilesX; }
+inline unsigned int TerrainStreamer::getTilesZ()      const { return header.tilesZ; }
+inline float        TerrainStreamer::getGroundScale() const { return header.groundScale; }
+inline float        TerrainStreamer::getTileExtent()  const { return (header.tileSize - 1) * header.groundScale; }
+inline unsigned int TerrainStreamer::getNumResident() const { return numResident; }
+inline std::size_t  TerrainStreamer::getMemoryUsed()  const { return numResident * tileBytes(); }
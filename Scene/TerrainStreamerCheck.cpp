@@ -0,0 +1,200 @@
+/************************************************************************/
+/* TerrainStreamerCheck
+/* --------------------
+/* Headless round trip of the TerrainStreamer, run from the command
+/* line without opening a window
+/************************************************************************/
+#include "TerrainStreamerCheck.h"
+#include "TerrainStreamer.h"
+#include "../Utility/HeightGrid.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <ostream>
+#include <string>
+#include <vector>
+
+using namespace glm;
+
+
+namespace
+{
+	const std::string filename("verify-streamer.tiles");
+
+	// A small world, so the whole check runs in well under a second
+	const unsigned int tileSize    = 33;
+	const unsigned int tilesX      = 6;
+	const unsigned int tilesZ      = 5;
+	const float        groundScale = 2.f;
+	const float        minHeight   = 0.f;
+	const float        maxHeight   = 100.f;
+
+	// Deterministic rolling ground with some per-vertex noise, so a
+	// tile read from the wrong place or a swapped edge shows up
+	float worldHeight(const unsigned int x, const unsigned int z)
+	{
+		unsigned int h = x * 73856093u ^ z * 19349663u;
+		h ^= h >> 13;
+		h *= 0x5bd1e995u;
+		h ^= h >> 15;
+		const float noise = (h & 0xffff) / 65535.f * 2.f - 1.f;
+
+		return 50.f + 25.f * std::sin(x * 0.07f) * std::cos(z * 0.05f)
+					+ 10.f * std::sin((x + 2.f * z) * 0.31f)
+					+ 2.f * noise;
+	}
+
+	// Interpolate the source world the same way the streamer does
+	float referenceAt(const HeightGrid& world, const float x, const float z)
+	{
+		const float gx = x / groundScale;
+		const float gz = z / groundScale;
+		const unsigned int x0 = std::min(static_cast<unsigned int>(gx), world.getWidth()  - 2);
+		const unsigned int z0 = std::min(static_cast<unsigned int>(gz), world.getHeight() - 2);
+		const float dx = gx - x0;
+		const float dz = gz - z0;
+
+		const float h1 = world.at(x0,     z0) + dz * (world.at(x0,     z0 + 1) - world.at(x0,     z0));
+		const float h2 = world.at(x0 + 1, z0) + dz * (world.at(x0 + 1, z0 + 1) - world.at(x0 + 1, z0));
+		return h1 + dx * (h2 - h1);
+	}
+
+	// Small deterministic generator so runs are repeatable anywhere
+	class Lcg
+	{
+	private:
+		unsigned int state;
+
+	public:
+		Lcg(const unsigned int seed) : state(seed) { }
+
+		// Uniform float in [lo,hi)
+		float next(const float lo, const float hi)
+		{
+			state = state * 1664525u + 1013904223u;
+			return lo + (hi - lo) * ((state >> 8) * (1.f / 16777216.f));
+		}
+	};
+
+	void report(std::ostream& out, const char *name, const bool ok)
+	{
+		out << name << (ok ? "  ok" : "  FAILED") << std::endl;
+	}
+}
+
+
+bool streamercheck::verify( std::ostream& out )
+{
+	const unsigned int span = tileSize - 1;
+	HeightGrid world(tilesX * span + 1, tilesZ * span + 1);
+	for(unsigned int z = 0; z < world.getHeight(); ++z)
+	for(unsigned int x = 0; x < world.getWidth(); ++x)
+		world.at(x, z) = worldHeight(x, z);
+
+	const bool written = TerrainStreamer::write(filename, tileSize, tilesX, tilesZ
+											  , groundScale, minHeight, maxHeight
+											  , [&](unsigned int tx, unsigned int tz, HeightGrid& grid)
+	{
+		for(unsigned int z = 0; z < tileSize; ++z)
+		for(unsigned int x = 0; x < tileSize; ++x)
+			grid.at(x, z) = world.at(tx * span + x, tz * span + z);
+	});
+	report(out, "write tiles", written);
+
+	TerrainStreamer streamer;
+	const bool opened = written && streamer.open(filename);
+	report(out, "open tiles", opened);
+	if( !opened )
+	{
+		std::remove(filename.c_str());
+		out << "Terrain streamer: FAILED" << std::endl;
+		return false;
+	}
+
+	const float extent   = streamer.getTileExtent();
+	const float sizeX    = tilesX * extent;
+	const float sizeZ    = tilesZ * extent;
+	const unsigned int numTiles = tilesX * tilesZ;
+	const std::size_t  tileBytes = tileSize * tileSize * sizeof(float);
+	const float offMap   = std::numeric_limits<float>::min();
+
+	// Heights are stored in 16 bit steps, interpolating them can't
+	// stray further than one step from the source
+	const float tolerance = (maxHeight - minHeight) / 65535.f + 1e-3f;
+
+	// Everything resident: every border and random points agree
+	streamer.setMemoryBudget(numTiles * tileBytes);
+	streamer.update(vec3(0.5f * sizeX, 0.f, 0.5f * sizeZ), sizeX + sizeZ);
+	streamer.flush();
+	const bool allResident = (streamer.getNumResident() == numTiles);
+	report(out, "all tiles resident", allResident);
+
+	std::vector<vec2> points;
+	const float offsets[] = { -0.3f, 0.f, 0.3f };
+	for(unsigned int k = 1; k < tilesX; ++k)
+	for(unsigned int o = 0; o < 3; ++o)
+	for(float z = 0.f; z < sizeZ; z += 0.7f)
+		points.push_back(vec2(k * extent + offsets[o], z));
+	for(unsigned int k = 1; k < tilesZ; ++k)
+	for(unsigned int o = 0; o < 3; ++o)
+	for(float x = 0.f; x < sizeX; x += 0.7f)
+		points.push_back(vec2(x, k * extent + offsets[o]));
+	Lcg rng(7u);
+	for(unsigned int i = 0; i < 2000; ++i)
+		points.push_back(vec2(rng.next(0.f, sizeX), rng.next(0.f, sizeZ)));
+
+	std::vector<float> heights(points.size());
+	streamer.heightsAt(&points[0], points.size(), &heights[0]);
+	float maxError = 0.f;
+	for(unsigned int i = 0; i < points.size(); ++i)
+	{
+		const float error = (heights[i] == offMap) ? std::numeric_limits<float>::max()
+						  : std::abs(heights[i] - referenceAt(world, points[i].x, points[i].y));
+		maxError = std::max(maxError, error);
+	}
+	const bool heightsMatch = (maxError <= tolerance);
+	out << "heights at " << points.size() << " points, max error " << maxError
+		<< (heightsMatch ? "  ok" : "  FAILED") << std::endl;
+
+	const bool offWorld = streamer.heightAt(-1.f, 0.5f * sizeZ) == offMap
+					   && streamer.heightAt(0.5f * sizeX, sizeZ + 1.f) == offMap;
+	report(out, "off the world", offWorld);
+	bool passed = allResident && heightsMatch && offWorld;
+
+	// Walk a budget of four tiles from one corner to the other, the
+	// tile underfoot must always be resident and the start evicted
+	const unsigned int budgetTiles = 4;
+	streamer.setMemoryBudget(budgetTiles * tileBytes);
+	bool overBudget = false, missing = false;
+	float walkError = 0.f;
+	for(float t = 0.f; t <= 1.f; t += 1.f / 64.f)
+	{
+		const vec3 position(0.5f * extent + t * (sizeX - extent), 0.f
+						  , 0.5f * extent + t * (sizeZ - extent));
+		streamer.update(position, 0.4f * extent);
+		streamer.flush();
+
+		overBudget = overBudget || streamer.getMemoryUsed() > budgetTiles * tileBytes;
+		const float height = streamer.heightAt(position.x, position.z);
+		if( height == offMap )
+			missing = true;
+		else
+			walkError = std::max(walkError, std::abs(height - referenceAt(world, position.x, position.z)));
+	}
+	const bool evicted = !streamer.isResident(0, 0)
+					  && streamer.heightAt(0.5f * extent, 0.5f * extent) == offMap;
+	report(out, "walk stays within budget", !overBudget);
+	report(out, "walk tile underfoot resident", !missing && walkError <= tolerance);
+	report(out, "walk evicts tiles left behind", evicted);
+	passed = passed && !overBudget && !missing && walkError <= tolerance && evicted;
+
+	streamer.close();
+	std::remove(filename.c_str());
+
+	out << (passed ? "Terrain streamer: passed" : "Terrain streamer: FAILED") << std::endl;
+	return passed;
+}
@@ -0,0 +1,18 @@
+#pragma once
+/************************************************************************/
+/* TerrainStreamerCheck
+/* --------------------
+/* Headless round trip of the TerrainStreamer, run from the command
+/* line without opening a window
+/************************************************************************/
+#include <ostream>
+
+
+namespace streamercheck
+{
+	// Write a procedural world as a tiled height file, stream it back
+	// in and compare heights across tile borders against the source,
+	// then walk a small budget over it and check tiles are evicted.
+	// False if any check fails.
+	bool verify(std::ostream& out);
+};
@@ -0,0 +1,303 @@
+/************************************************************************/
+/* Aabb
+/* ----
+/* Exact tests on axis aligned boxes given by their min and max
+/* corners, singly or one against many boxes stored by bound
+/************************************************************************/
+#include "Aabb.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cassert>
+
+// SSE2 intrinsics are available to every x86 build target of MSVC
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define AABB_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace glm;
+
+
+namespace
+{
+	vec3 minOf(const aabb::BoxArray& boxes, const unsigned int i)
+	{
+		return vec3(boxes.minX[i], boxes.minY[i], boxes.minZ[i]);
+	}
+
+	vec3 maxOf(const aabb::BoxArray& boxes, const unsigned int i)
+	{
+		return vec3(boxes.maxX[i], boxes.maxY[i], boxes.maxZ[i]);
+	}
+
+#ifdef AABB_SSE2
+	// Overlap mask of boxes i to i+3 against a box splatted into lo, hi
+	inline __m128 overlap4( const aabb::BoxArray& boxes, const unsigned int i
+						  , const __m128 lo[3], const __m128 hi[3] )
+	{
+		const __m128 x = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(&boxes.minX[i]), hi[0])
+								  , _mm_cmple_ps(lo[0], _mm_loadu_ps(&boxes.maxX[i])));
+		const __m128 y = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(&boxes.minY[i]), hi[1])
+								  , _mm_cmple_ps(lo[1], _mm_loadu_ps(&boxes.maxY[i])));
+		const __m128 z = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(&boxes.minZ[i]), hi[2])
+								  , _mm_cmple_ps(lo[2], _mm_loadu_ps(&boxes.maxZ[i])));
+		return _mm_and_ps(x, _mm_and_ps(y, z));
+	}
+
+	void splat(const vec3& v, __m128 out[3])
+	{
+		out[0] = _mm_set1_ps(v.x);
+		out[1] = _mm_set1_ps(v.y);
+		out[2] = _mm_set1_ps(v.z);
+	}
+#endif
+}
+
+
+void aabb::BoxArray::add( const vec3& minBound, const vec3& maxBound )
+{
+	minX.push_back(minBound.x); minY.push_back(minBound.y); minZ.push_back(minBound.z);
+	maxX.push_back(maxBound.x); maxY.push_back(maxBound.y); maxZ.push_back(maxBound.z);
+}
+
+void aabb::BoxArray::set( const unsigned int i, const vec3& minBound, const vec3& maxBound )
+{
+	assert(i < size());
+	minX[i] = minBound.x; minY[i] = minBound.y; minZ[i] = minBound.z;
+	maxX[i] = maxBound.x; maxY[i] = maxBound.y; maxZ[i] = maxBound.z;
+}
+
+void aabb::BoxArray::clear()
+{
+	minX.clear(); minY.clear(); minZ.clear();
+	maxX.clear(); maxY.clear(); maxZ.clear();
+}
+
+bool aabb::intersectRay( const vec3& minBound, const vec3& maxBound
+					   , const vec3& origin, const vec3& direction
+					   , const float maxDistance, float& distance )
+{
+	float tEnter = 0.f;
+	float tExit  = maxDistance;
+	for(int k = 0; k < 3; ++k)
+	{
+		// Parallel to a slab the ray is either always in it or never
+		if( direction[k] == 0.f )
+		{
+			if( origin[k] < minBound[k] || origin[k] > maxBound[k] )
+				return false;
+			continue;
+		}
+
+		float t0 = (minBound[k] - origin[k]) / direction[k];
+		float t1 = (maxBound[k] - origin[k]) / direction[k];
+		if( t0 > t1 )
+			std::swap(t0, t1);
+
+		tEnter = std::max(tEnter, t0);
+		tExit  = std::min(tExit,  t1);
+	}
+	if( tEnter > tExit )
+		return false;
+
+	distance = tEnter;
+	return true;
+}
+
+Frustum::Result aabb::intersectFrustum( const Frustum& frustum
+									  , const vec3& minBound
+									  , const vec3& maxBound )
+{
+	Frustum::Result result = Frustum::inside;
+	for(unsigned int i = 0; i < Frustum::num_sides; ++i)
+	{
+		const vec4& p = frustum.plane(static_cast<Frustum::Side>(i));
+
+		// Corner furthest along the plane normal, and the one opposite
+		const vec3 positive( p.x >= 0.f ? maxBound.x : minBound.x
+						   , p.y >= 0.f ? maxBound.y : minBound.y
+						   , p.z >= 0.f ? maxBound.z : minBound.z );
+		const vec3 negative( p.x >= 0.f ? minBound.x : maxBound.x
+						   , p.y >= 0.f ? minBound.y : maxBound.y
+						   , p.z >= 0.f ? minBound.z : maxBound.z );
+
+		if( dot(vec3(p), positive) + p.w < 0.f )
+			return Frustum::outside;
+		if( dot(vec3(p), negative) + p.w < 0.f )
+			result = Frustum::intersecting;
+	}
+
+	// Boxes off past a corner of the frustum straddle two planes
+	// without touching it, but they miss the frustum's own bounds
+	if( result == Frustum::intersecting
+	 && !overlap(minBound, maxBound, frustum.getMinBound(), frustum.getMaxBound()) )
+		return Frustum::outside;
+
+	return result;
+}
+
+void aabb::overlap( const BoxArray& boxes
+				  , const vec3& minBound, const vec3& maxBound
+				  , bool *results )
+{
+	const unsigned int count = boxes.size();
+	unsigned int i = 0;
+#ifdef AABB_SSE2
+	__m128 lo[3], hi[3];
+	splat(minBound, lo);
+	splat(maxBound, hi);
+	for(; i + 4 <= count; i += 4)
+	{
+		const int mask = _mm_movemask_ps(overlap4(boxes, i, lo, hi));
+		for(unsigned int k = 0; k < 4; ++k)
+			results[i + k] = ((mask >> k) & 1) != 0;
+	}
+#endif
+	for(; i < count; ++i)
+		results[i] = overlap(minOf(boxes, i), maxOf(boxes, i), minBound, maxBound);
+}
+
+void aabb::contains( const BoxArray& boxes, const vec3& point, bool *results )
+{
+	overlap(boxes, point, point, results);
+}
+
+int aabb::findOverlap( const BoxArray& boxes
+					 , const vec3& minBound, const vec3& maxBound
+					 , const unsigned int first )
+{
+	const unsigned int count = boxes.size();
+	unsigned int i = first;
+#ifdef AABB_SSE2
+	__m128 lo[3], hi[3];
+	splat(minBound, lo);
+	splat(maxBound, hi);
+	for(; i + 4 <= count; i += 4)
+	{
+		const int mask = _mm_movemask_ps(overlap4(boxes, i, lo, hi));
+		if( mask != 0 )
+		{
+			for(unsigned int k = 0; k < 4; ++k)
+			{
+				if( (mask >> k) & 1 )
+					return i + k;
+			}
+		}
+	}
+#endif
+	for(; i < count; ++i)
+	{
+		if( overlap(minOf(boxes, i), maxOf(boxes, i), minBound, maxBound) )
+			return i;
+	}
+	return -1;
+}
+
+void aabb::intersectRay( const BoxArray& boxes
+					   , const vec3& origin, const vec3& direction
+					   , const float maxDistance, float *distances )
+{
+	const unsigned int count = boxes.size();
+	unsigned int i = 0;
+#ifdef AABB_SSE2
+	const std::vector<float> *mins[3] = { &boxes.minX, &boxes.minY, &boxes.minZ };
+	const std::vector<float> *maxs[3] = { &boxes.maxX, &boxes.maxY, &boxes.maxZ };
+	const __m128 zero4 = _mm_setzero_ps();
+	const __m128 miss4 = _mm_set1_ps(-1.f);
+	const __m128 far4  = _mm_set1_ps(maxDistance);
+	__m128 o[3], d[3];
+	splat(origin, o);
+	splat(direction, d);
+
+	for(; i + 4 <= count; i += 4)
+	{
+		__m128 tEnter = zero4;
+		__m128 tExit  = far4;
+		__m128 valid  = _mm_cmpeq_ps(zero4, zero4);
+		for(int k = 0; k < 3; ++k)
+		{
+			const __m128 lo = _mm_loadu_ps(&(*mins[k])[i]);
+			const __m128 hi = _mm_loadu_ps(&(*maxs[k])[i]);
+			if( direction[k] == 0.f )
+			{
+				valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmple_ps(lo, o[k]), _mm_cmple_ps(o[k], hi)));
+				continue;
+			}
+
+			const __m128 t0 = _mm_div_ps(_mm_sub_ps(lo, o[k]), d[k]);
+			const __m128 t1 = _mm_div_ps(_mm_sub_ps(hi, o[k]), d[k]);
+			tEnter = _mm_max_ps(tEnter, _mm_min_ps(t0, t1));
+			tExit  = _mm_min_ps(tExit,  _mm_max_ps(t0, t1));
+		}
+
+		const __m128 hit = _mm_and_ps(valid, _mm_cmple_ps(tEnter, tExit));
+		_mm_storeu_ps(distances + i, _mm_or_ps(_mm_and_ps(hit, tEnter), _mm_andnot_ps(hit, miss4)));
+	}
+#endif
+	for(; i < count; ++i)
+	{
+		float distance;
+		distances[i] = intersectRay(minOf(boxes, i), maxOf(boxes, i), origin, direction, maxDistance, distance)
+					 ? distance : -1.f;
+	}
+}
+
+void aabb::intersectFrustum( const Frustum& frustum, const BoxArray& boxes
+						   , Frustum::Result *results )
+{
+	const unsigned int count = boxes.size();
+	unsigned int i = 0;
+#ifdef AABB_SSE2
+	__m128 lo[3], hi[3];
+	splat(frustum.getMinBound(), lo);
+	splat(frustum.getMaxBound(), hi);
+	const __m128 zero4 = _mm_setzero_ps();
+
+	for(; i + 4 <= count; i += 4)
+	{
+		const __m128 bound[2][3] = {
+			{ _mm_loadu_ps(&boxes.minX[i]), _mm_loadu_ps(&boxes.minY[i]), _mm_loadu_ps(&boxes.minZ[i]) },
+			{ _mm_loadu_ps(&boxes.maxX[i]), _mm_loadu_ps(&boxes.maxY[i]), _mm_loadu_ps(&boxes.maxZ[i]) }
+		};
+
+		__m128 outside = zero4;
+		__m128 across  = zero4;
+		for(unsigned int s = 0; s < Frustum::num_sides; ++s)
+		{
+			const vec4& p = frustum.plane(static_cast<Frustum::Side>(s));
+			const int px = (p.x >= 0.f) ? 1 : 0;
+			const int py = (p.y >= 0.f) ? 1 : 0;
+			const int pz = (p.z >= 0.f) ? 1 : 0;
+			const __m128 nx = _mm_set1_ps(p.x);
+			const __m128 ny = _mm_set1_ps(p.y);
+			const __m128 nz = _mm_set1_ps(p.z);
+			const __m128 w  = _mm_set1_ps(p.w);
+
+			const __m128 positive = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(nx, bound[px][0]), _mm_mul_ps(ny, bound[py][1])), _mm_mul_ps(nz, bound[pz][2])), w);
+			const __m128 negative = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(nx, bound[1 - px][0]), _mm_mul_ps(ny, bound[1 - py][1])), _mm_mul_ps(nz, bound[1 - pz][2])), w);
+
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(positive, zero4));
+			across  = _mm_or_ps(across,  _mm_cmplt_ps(negative, zero4));
+		}
+		const int outMask   = _mm_movemask_ps(outside);
+		const int crossMask = _mm_movemask_ps(across);
+		const int nearMask  = _mm_movemask_ps(overlap4(boxes, i, lo, hi));
+
+		for(unsigned int k = 0; k < 4; ++k)
+		{
+			if( (outMask >> k) & 1 )
+				results[i + k] = Frustum::outside;
+			else if( (crossMask >> k) & 1 )
+				results[i + k] = ((nearMask >> k) & 1) ? Frustum::intersecting : Frustum::outside;
+			else
+				results[i + k] = Frustum::inside;
+		}
+	}
+#endif
+	for(; i < count; ++i)
+		results[i] = intersectFrustum(frustum, minOf(boxes, i), maxOf(boxes, i));
+}
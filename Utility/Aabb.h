@@ -0,0 +1,87 @@
+#pragma once
+/************************************************************************/
+/* Aabb
+/* ----
+/* Exact tests on axis aligned boxes given by their min and max
+/* corners, singly or one against many boxes stored by bound
+/************************************************************************/
+#include "Frustum.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+
+namespace aabb
+{
+	// Many boxes kept as one array per bound, so the batched tests
+	// can load the same bound of four boxes at once
+	struct BoxArray
+	{
+		std::vector<float> minX, minY, minZ;
+		std::vector<float> maxX, maxY, maxZ;
+
+		void add(const glm::vec3& minBound, const glm::vec3& maxBound);
+		void set(const unsigned int i, const glm::vec3& minBound, const glm::vec3& maxBound);
+		void clear();
+		unsigned int size() const;
+	};
+
+	// Closed boxes, so touching along a face counts
+	bool overlap( const glm::vec3& minA, const glm::vec3& maxA
+				, const glm::vec3& minB, const glm::vec3& maxB );
+	bool contains( const glm::vec3& minBound, const glm::vec3& maxBound
+				 , const glm::vec3& point );
+
+	// Slab test of a ray against a box, distance is set in multiples
+	// of direction to where the ray enters the box, or 0 if it starts
+	// inside, false if it doesn't reach the box within maxDistance
+	bool intersectRay( const glm::vec3& minBound, const glm::vec3& maxBound
+					 , const glm::vec3& origin, const glm::vec3& direction
+					 , const float maxDistance, float& distance );
+
+	// A box is outside if it's behind any plane of the frustum or
+	// apart from the box around the frustum's corners, inside if it's
+	// in front of every plane and otherwise intersecting
+	Frustum::Result intersectFrustum( const Frustum& frustum
+									, const glm::vec3& minBound
+									, const glm::vec3& maxBound );
+
+	// One box against many, four at a time where SSE2 is available,
+	// filling one result per box
+	void overlap( const BoxArray& boxes
+				, const glm::vec3& minBound, const glm::vec3& maxBound
+				, bool *results );
+	void contains(const BoxArray& boxes, const glm::vec3& point, bool *results);
+	// Distances are negative for boxes the ray misses
+	void intersectRay( const BoxArray& boxes
+					 , const glm::vec3& origin, const glm::vec3& direction
+					 , const float maxDistance, float *distances );
+	void intersectFrustum( const Frustum& frustum, const BoxArray& boxes
+						 , Frustum::Result *results );
+
+	// Index of the first box at or after first overlapping a box,
+	// or -1 if none does
+	int findOverlap( const BoxArray& boxes
+				   , const glm::vec3& minBound, const glm::vec3& maxBound
+				   , const unsigned int first = 0 );
+};
+
+
+inline bool aabb::overlap( const glm::vec3& minA, const glm::vec3& maxA
+						 , const glm::vec3& minB, const glm::vec3& maxB )
+{
+	return minA.x <= maxB.x && minB.x <= maxA.x
+		&& minA.y <= maxB.y && minB.y <= maxA.y
+		&& minA.z <= maxB.z && minB.z <= maxA.z;
+}
+
+inline bool aabb::contains( const glm::vec3& minBound, const glm::vec3& maxBound
+						  , const glm::vec3& point )
+{
+	return point.x >= minBound.x && point.x <= maxBound.x
+		&& point.y >= minBound.y && point.y <= maxBound.y
+		&& point.z >= minBound.z && point.z <= maxBound.z;
+}
+
+inline unsigned int aabb::BoxArray::size() const { return minX.size(); }
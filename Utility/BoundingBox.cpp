@@ -5,6 +5,7 @@
 /************************************************************************/
 
 #include "BoundingBox.h"
+#include "Aabb.h"
 #include <iostream>
 
 
@@ -22,15 +23,14 @@ BoundingBox::BoundingBox(MeshOverlay& mesh)
 	edges[0] = mesh.vertexAt(0,0);
 	edges[1] = mesh.vertexAt(0,0);
 
-	for(unsigned int i = 0; i < mesh.getWidth() ; ++i)
+	// Rows are contiguous, so scan the whole grid as one run
+	const glm::vec3 *vertex = mesh.vertexRow(0);
+	for(unsigned int i = 0; i < mesh.getNumVertices(); ++i)
 	{
-		for(unsigned int j = 0; j < mesh.getHeight(); ++j)
+		for(int k = 0; k < 3; ++k)
 		{
-			for(int k = 0; k < 3; ++k)
-			{
-				edges[0][k] = edges[0][k] < mesh.vertexAt(i , j)[k] ? edges[0][k] : mesh.vertexAt(i , j)[k];
-				edges[1][k] = edges[1][k] > mesh.vertexAt(i , j)[k] ? edges[1][k] : mesh.vertexAt(i , j)[k];
-			}
+			edges[0][k] = edges[0][k] < vertex[i][k] ? edges[0][k] : vertex[i][k];
+			edges[1][k] = edges[1][k] > vertex[i][k] ? edges[1][k] : vertex[i][k];
 		}
 	}	
 
@@ -68,57 +68,7 @@ BoundingBox::~BoundingBox()
 
 const bool BoundingBox::intersect(BoundingBox* box)
 {
-	//only uses corners, so its super imprecise and fairly inaccurate
-	float step = 50;
-	for(int i = 0; i < 2; ++i)
-	for(int j = 0; j < 2; ++j)
-	for(int k = 0; k < step; ++k)
-	if(this->inBox(glm::vec3(box->getEdges()[i].x, box->getEdges()[j].y, box->getEdges()[0].z) + 
-		(glm::length((glm::vec3(box->getEdges()[i].x, box->getEdges()[j].y, box->getEdges()[1].z) - glm::vec3(box->getEdges()[i].x, box->getEdges()[j].y, box->getEdges()[0].z))) / step) * k))
-		return true;
-
-	for(int i = 0; i < 2; ++i)
-	for(int j = 0; j < 2; ++j)
-	for(int k = 0; k < step; ++k)
-	if(this->inBox(glm::vec3(box->getEdges()[0].x, box->getEdges()[j].y, box->getEdges()[i].z) + 
-		(glm::length((glm::vec3(box->getEdges()[1].x, box->getEdges()[j].y, box->getEdges()[i].z) - glm::vec3(box->getEdges()[0].x, box->getEdges()[j].y, box->getEdges()[i].z))) / step) * k))
-		return true;
-
-	for(int i = 0; i < 2; ++i)
-	for(int j = 0; j < 2; ++j)
-	for(int k = 0; k < step; ++k)
-	if(this->inBox(glm::vec3(box->getEdges()[i].x, box->getEdges()[0].y, box->getEdges()[j].z) + 
-		(glm::length((glm::vec3(box->getEdges()[i].x, box->getEdges()[1].y, box->getEdges()[j].z) - glm::vec3(box->getEdges()[i].x, box->getEdges()[0].y, box->getEdges()[j].z))) / step) * k))
-		return true;
-
-	for(int i = 0; i < 2; ++i)
-	for(int j = 0; j < 2; ++j)
-	for(int k = 0; k < step; ++k)
-	if(box->inBox(glm::vec3(this->getEdges()[i].x, this->getEdges()[j].y, this->getEdges()[0].z) + 
-		(glm::length((glm::vec3(this->getEdges()[i].x, this->getEdges()[j].y, this->getEdges()[1].z) - glm::vec3(this->getEdges()[i].x, this->getEdges()[j].y, this->getEdges()[0].z))) / step) * k))
-		return true;
-
-	for(int i = 0; i < 2; ++i)
-	for(int j = 0; j < 2; ++j)
-	for(int k = 0; k < step; ++k)
-	if(box->inBox(glm::vec3(this->getEdges()[0].x, this->getEdges()[j].y, this->getEdges()[i].z) + 
-		(glm::length((glm::vec3(this->getEdges()[1].x, this->getEdges()[j].y, this->getEdges()[i].z) - glm::vec3(this->getEdges()[0].x, this->getEdges()[j].y, this->getEdges()[i].z))) / step) * k))
-		return true;
-
-	for(int i = 0; i < 2; ++i)
-	for(int j = 0; j < 2; ++j)
-	for(int k = 0; k < step; ++k)
-	if(box->inBox(glm::vec3(this->getEdges()[i].x, this->getEdges()[0].y, this->getEdges()[0].z) + 
-		(glm::length((glm::vec3(this->getEdges()[i].x, this->getEdges()[1].y, this->getEdges()[1].z) - glm::vec3(this->getEdges()[i].x, this->getEdges()[0].y, this->getEdges()[0].z))) / step) * k))
-		return true;
-
-	/*for(int i = 0; i < 2; ++i)
-	for(int j = 0; j < 2; ++j)
-	for(int k = 0; k < 2; ++k)
-	if(box->inBox(glm::vec3(this->getEdges()[i].x, this->getEdges()[j].y, this->getEdges()[k].z)))
-		return true;*/
-
-	return false;
+	return aabb::overlap(edges[0], edges[1], box->getEdges()[0], box->getEdges()[1]);
 }
 
 void BoundingBox::draw()
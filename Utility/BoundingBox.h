@@ -8,6 +8,7 @@
 #include "../Scene/Objects.h"
 #include "../Scene/SceneObject.h"
 #include "../Scene/MeshOverlay.h"
+#include "Aabb.h"
 
 #include <glm\glm.hpp>
 
@@ -38,11 +39,5 @@ inline const glm::mat2x3& BoundingBox::getEdges() { return edges;}
 
 inline const bool BoundingBox::inBox(glm::vec3 vec)
 {
-	if(	vec.x >= edges[0].x && vec.x <= edges[1].x &&
-		vec.y >= edges[0].y && vec.y <= edges[1].y &&
-		vec.z >= edges[0].z && vec.z <= edges[1].z)
-	{
-		return true;
-	}
-	return false;
+	return aabb::contains(edges[0], edges[1], vec);
 }
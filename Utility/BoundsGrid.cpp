@@ -0,0 +1,148 @@
+/************************************************************************/
+/* BoundsGrid
+/* ----------
+/* A uniform grid over the ground plane that indexes axis aligned
+/* boxes by the cells they cover, for exact overlap queries that
+/* only look at boxes nearby
+/************************************************************************/
+#include "BoundsGrid.h"
+#include "Parallel.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+using namespace glm;
+
+
+BoundsGrid::BoundsGrid( const vec2& minXZ, const vec2& maxXZ, const float cellSize )
+	: origin(minXZ)
+	, cellSize(cellSize)
+	, cellsX(1)
+	, cellsZ(1)
+	, boxes()
+	, ranges()
+	, cells()
+{
+	assert(cellSize > 0.f);
+	const vec2 size(max(maxXZ - minXZ, vec2(0.f)));
+	cellsX = std::max(1u, static_cast<unsigned int>(ceil(size.x / cellSize)));
+	cellsZ = std::max(1u, static_cast<unsigned int>(ceil(size.y / cellSize)));
+	cells.resize(cellsX * cellsZ);
+}
+
+unsigned int BoundsGrid::insert( const vec3& minBound, const vec3& maxBound )
+{
+	const unsigned int index = boxes.size();
+	const Box box = { minBound, maxBound };
+	const CellRange range = cellRange(minBound, maxBound);
+	boxes.push_back(box);
+	ranges.push_back(range);
+
+	for(unsigned int z = range.minz; z <= range.maxz; ++z)
+	for(unsigned int x = range.minx; x <= range.maxx; ++x)
+	{
+		Cell& cell = cells[z * cellsX + x];
+		cell.boxes.add(minBound, maxBound);
+		cell.indices.push_back(index);
+	}
+
+	return index;
+}
+
+void BoundsGrid::clear()
+{
+	boxes.clear();
+	ranges.clear();
+	for(unsigned int i = 0; i < cells.size(); ++i)
+	{
+		cells[i].boxes.clear();
+		cells[i].indices.clear();
+	}
+}
+
+BoundsGrid::CellRange BoundsGrid::cellRange( const vec3& minBound, const vec3& maxBound ) const
+{
+	// Clamp in floats first, so boxes far outside can't overflow
+	const vec2 last(cellsX - 1, cellsZ - 1);
+	const vec2 lo(clamp((vec2(minBound.x, minBound.z) - origin) / cellSize, vec2(0.f), last));
+	const vec2 hi(clamp((vec2(maxBound.x, maxBound.z) - origin) / cellSize, vec2(0.f), last));
+
+	CellRange range;
+	range.minx = static_cast<unsigned int>(lo.x);
+	range.minz = static_cast<unsigned int>(lo.y);
+	range.maxx = static_cast<unsigned int>(hi.x);
+	range.maxz = static_cast<unsigned int>(hi.y);
+	return range;
+}
+
+template<typename Visit>
+void BoundsGrid::forOverlaps( const vec3& minBound, const vec3& maxBound, Visit visit ) const
+{
+	const CellRange range = cellRange(minBound, maxBound);
+	for(unsigned int z = range.minz; z <= range.maxz; ++z)
+	for(unsigned int x = range.minx; x <= range.maxx; ++x)
+	{
+		const Cell& cell = cells[z * cellsX + x];
+		for(int i = aabb::findOverlap(cell.boxes, minBound, maxBound); i >= 0
+			  ; i = aabb::findOverlap(cell.boxes, minBound, maxBound, i + 1))
+		{
+			// A box covering several of the cells is only reported in
+			// the first cell it shares with the query
+			const unsigned int index = cell.indices[i];
+			const CellRange& other = ranges[index];
+			if( x != std::max(range.minx, other.minx) || z != std::max(range.minz, other.minz) )
+				continue;
+
+			if( !visit(index) )
+				return;
+		}
+	}
+}
+
+bool BoundsGrid::overlaps( const vec3& minBound, const vec3& maxBound ) const
+{
+	bool found = false;
+	forOverlaps(minBound, maxBound, [&](unsigned int) -> bool
+	{
+		found = true;
+		return false;
+	});
+	return found;
+}
+
+void BoundsGrid::query( const vec3& minBound, const vec3& maxBound
+					  , std::vector<unsigned int>& hits ) const
+{
+	forOverlaps(minBound, maxBound, [&](unsigned int index) -> bool
+	{
+		hits.push_back(index);
+		return true;
+	});
+}
+
+bool BoundsGrid::contains( const vec3& point ) const
+{
+	return overlaps(point, point);
+}
+
+void BoundsGrid::overlaps( const Box *queries, const unsigned int count, bool *results ) const
+{
+	// Queries only read the index, so any number can run at once
+	parallel::forRange(0, count, [&](unsigned int begin, unsigned int end)
+	{
+		for(unsigned int i = begin; i < end; ++i)
+			results[i] = overlaps(queries[i].minBound, queries[i].maxBound);
+	}, 256);
+}
+
+void BoundsGrid::contains( const vec3 *points, const unsigned int count, bool *results ) const
+{
+	parallel::forRange(0, count, [&](unsigned int begin, unsigned int end)
+	{
+		for(unsigned int i = begin; i < end; ++i)
+			results[i] = contains(points[i]);
+	}, 256);
+}
@@ -0,0 +1,97 @@
+#pragma once
+/************************************************************************/
+/* BoundsGrid
+/* ----------
+/* A uniform grid over the ground plane that indexes axis aligned
+/* boxes by the cells they cover, for exact overlap queries that
+/* only look at boxes nearby
+/************************************************************************/
+#include "Aabb.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+
+class BoundsGrid
+{
+public:
+	struct Box
+	{
+		glm::vec3 minBound;
+		glm::vec3 maxBound;
+	};
+
+private:
+	// Inclusive range of cells a box covers
+	struct CellRange
+	{
+		unsigned int minx, minz;
+		unsigned int maxx, maxz;
+	};
+
+	glm::vec2 origin;      // xz of the first cell's corner
+	float cellSize;
+	unsigned int cellsX;
+	unsigned int cellsZ;
+
+	// The boxes in a cell, and where each is in the index
+	struct Cell
+	{
+		aabb::BoxArray boxes;
+		std::vector<unsigned int> indices;
+	};
+
+	std::vector<Box> boxes;
+	std::vector<CellRange> ranges;
+	std::vector<Cell> cells;    // row-major
+
+public:
+	/**
+	 * Create an empty index over an area of the xz plane, boxes reaching
+	 * past the area are kept in the cells along its edges
+	 * \param minXZ, maxXZ - the corners of the area
+	 * \param cellSize     - the width of a cell, about the size of a
+	 *                       typical box works best
+	**/
+	BoundsGrid(const glm::vec2& minXZ, const glm::vec2& maxXZ, const float cellSize);
+
+	// Add a box, returning its index
+	unsigned int insert(const glm::vec3& minBound, const glm::vec3& maxBound);
+	// Remove every box, keeping the area and cells
+	void clear();
+
+	// True if a box overlaps any in the index, boxes that only touch
+	// along a face count as overlapping like aabb::overlap
+	bool overlaps(const glm::vec3& minBound, const glm::vec3& maxBound) const;
+	// Collect the index of every box overlapping a box
+	void query( const glm::vec3& minBound, const glm::vec3& maxBound
+			  , std::vector<unsigned int>& hits ) const;
+	// True if a point is inside any box
+	bool contains(const glm::vec3& point) const;
+
+	// Test count boxes at once in parallel, as overlaps() would
+	void overlaps(const Box *queries, const unsigned int count, bool *results) const;
+	// Test count points at once in parallel, as contains() would
+	void contains(const glm::vec3 *points, const unsigned int count, bool *results) const;
+
+	unsigned int getNumBoxes() const;
+	const Box&   getBox(const unsigned int i) const;
+
+private:
+	CellRange cellRange(const glm::vec3& minBound, const glm::vec3& maxBound) const;
+
+	// Visit each box overlapping a box once, stopping early if
+	// visit returns false
+	template<typename Visit>
+	void forOverlaps( const glm::vec3& minBound, const glm::vec3& maxBound
+					, Visit visit ) const;
+
+	// No copying
+	BoundsGrid(const BoundsGrid&);
+	BoundsGrid& operator=(const BoundsGrid&);
+};
+
+
+inline unsigned int BoundsGrid::getNumBoxes() const { return boxes.size(); }
+inline const BoundsGrid::Box& BoundsGrid::getBox(const unsigned int i) const { return boxes[i]; }
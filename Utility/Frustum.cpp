@@ -0,0 +1,103 @@
+/************************************************************************/
+/* Frustum
+/* -------
+/* The six clipping planes of a camera, for visibility tests
+/************************************************************************/
+#include "Frustum.h"
+#include "Aabb.h"
+
+#include <glm/glm.hpp>
+
+#include <limits>
+
+using namespace glm;
+
+
+namespace
+{
+	// Point where three planes meet, false if any two are parallel
+	bool meet(const vec4& a, const vec4& b, const vec4& c, vec3& point)
+	{
+		const vec3 bc(cross(vec3(b), vec3(c)));
+		const float det = dot(vec3(a), bc);
+		if( abs(det) < 1e-12f )
+			return false;
+
+		point = -(a.w * bc + b.w * cross(vec3(c), vec3(a)) + c.w * cross(vec3(a), vec3(b))) / det;
+		return true;
+	}
+}
+
+
+Frustum::Frustum()
+	: minBound(-std::numeric_limits<float>::max())
+	, maxBound( std::numeric_limits<float>::max())
+{
+	for(unsigned int i = 0; i < num_sides; ++i)
+		planes[i] = vec4(0.f, 0.f, 0.f, 1.f);
+}
+
+Frustum::Frustum( const mat4& projection, const mat4& view )
+{
+	extract(projection * view);
+}
+
+void Frustum::extract( const mat4& clip )
+{
+	// Gribb & Hartmann: each plane is the last row of the 
+	// clip matrix plus or minus one of the other rows
+	// (glm matrices are column major, so rows are gathered by hand)
+	vec4 rows[4];
+	for(unsigned int r = 0; r < 4; ++r)
+		rows[r] = vec4(clip[0][r], clip[1][r], clip[2][r], clip[3][r]);
+
+	planes[left]      = rows[3] + rows[0];
+	planes[right]     = rows[3] - rows[0];
+	planes[bottom]    = rows[3] + rows[1];
+	planes[top]       = rows[3] - rows[1];
+	planes[near_side] = rows[3] + rows[2];
+	planes[far_side]  = rows[3] - rows[2];
+
+	for(unsigned int i = 0; i < num_sides; ++i)
+	{
+		const float len = length(vec3(planes[i]));
+		if( len > 0.f )
+			planes[i] /= len;
+	}
+
+	// Bound the corners, leaving the bounds open if the planes don't 
+	// close, a far plane at infinity gives corners out at infinity
+	minBound = vec3(-std::numeric_limits<float>::max());
+	maxBound = vec3( std::numeric_limits<float>::max());
+
+	vec3 lo( std::numeric_limits<float>::max());
+	vec3 hi(-std::numeric_limits<float>::max());
+	for(unsigned int i = 0; i < 8; ++i)
+	{
+		vec3 corner;
+		if( !meet(planes[(i & 1) ? right : left]
+				, planes[(i & 2) ? top : bottom]
+				, planes[(i & 4) ? far_side : near_side], corner) )
+			return;
+
+		lo = min(lo, corner);
+		hi = max(hi, corner);
+	}
+	minBound = lo;
+	maxBound = hi;
+}
+
+Frustum::Result Frustum::testBox( const vec3& minBound, const vec3& maxBound ) const
+{
+	return aabb::intersectFrustum(*this, minBound, maxBound);
+}
+
+bool Frustum::containsPoint( const vec3& point ) const
+{
+	for(unsigned int i = 0; i < num_sides; ++i)
+	{
+		if( dot(vec3(planes[i]), point) + planes[i].w < 0.f )
+			return false;
+	}
+	return true;
+}
@@ -0,0 +1,48 @@
+#pragma once
+/************************************************************************/
+/* Frustum
+/* -------
+/* The six clipping planes of a camera, for visibility tests
+/************************************************************************/
+#include <glm/glm.hpp>
+
+
+class Frustum
+{
+public:
+	enum Side { left, right, bottom, top, near_side, far_side, num_sides };
+	enum Result { outside, intersecting, inside };
+
+private:
+	// (normal, distance) with normals pointing into the frustum
+	glm::vec4 planes[num_sides];
+	// Box around the eight corners, everything for the default frustum
+	glm::vec3 minBound;
+	glm::vec3 maxBound;
+
+public:
+	// Create a frustum that contains everything
+	Frustum();
+	// Create the frustum of the given view and projection matrices
+	Frustum(const glm::mat4& projection, const glm::mat4& view);
+
+	// Extract the planes from a combined clip matrix (projection * view)
+	void extract(const glm::mat4& clip);
+
+	// Classify an axis aligned box against the frustum, boxes outside
+	// the planes or outside the frustum's own bounds are outside, so
+	// only boxes across an edge of the frustum can wrongly report
+	// intersecting
+	Result testBox(const glm::vec3& minBound, const glm::vec3& maxBound) const;
+	// Is a point inside the frustum?
+	bool containsPoint(const glm::vec3& point) const;
+
+	const glm::vec4& plane(const Side side) const;
+	const glm::vec3& getMinBound() const;
+	const glm::vec3& getMaxBound() const;
+};
+
+
+inline const glm::vec4& Frustum::plane(const Side side) const { return planes[side]; }
+inline const glm::vec3& Frustum::getMinBound() const { return minBound; }
+inline const glm::vec3& Frustum::getMaxBound() const { return maxBound; }
@@ -0,0 +1,181 @@
+/************************************************************************/
+/* GridIndices
+/* -----------
+/* Shared index buffers for regular grids of vertices, 
+/* cached by grid dimensions and triangulation
+/************************************************************************/
+#include "../Lib/glee/GLee.h"
+
+#include "GridIndices.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <cassert>
+#include <sstream>
+
+
+GridIndices::GridIndices( const unsigned int width
+						, const unsigned int height
+						, const Winding winding )
+	: width(width)
+	, height(height)
+	, winding(winding)
+	, type(GL_UNSIGNED_INT)
+	, restartIndex(0xffffffff)
+	, shortIndices(false)
+	, listCount(0)
+	, stripCount(0)
+	, listStats()
+{
+	assert(width >= 2 && height >= 2);
+
+	// The largest 16 bit value is reserved as the restart index
+	if( width * height < 0xffff )
+	{
+		type         = GL_UNSIGNED_SHORT;
+		restartIndex = 0xffff;
+		shortIndices = true;
+		build(list16, strip16);
+	}
+	else
+		build(list32, strip32);
+}
+
+template<typename T>
+void GridIndices::build( std::vector<T>& list, std::vector<T>& strip )
+{
+	// Squares go in bands of a few columns, row by row down each band.
+	// A band's row of vertices is still in the post-transform cache
+	// when the next row reuses it, which a full grid row is too long
+	// for, and the first row's two rows of vertices fit in it together.
+	const unsigned int numQuads = (width - 1) * (height - 1);
+	listCount = 6 * numQuads;
+	list.resize(listCount);
+
+	unsigned int i = 0;
+	for(unsigned int x0 = 0; x0 < (width - 1); x0 += bandWidth)
+	{
+		const unsigned int x1 = std::min(x0 + bandWidth, width - 1);
+		for(unsigned int z = 0;  z < (height - 1); ++z)
+		for(unsigned int x = x0; x < x1; ++x)
+		{
+			const T i0 = static_cast<T>(width *  z    +  x);
+			const T i1 = static_cast<T>(width * (z+1) +  x);
+			const T i2 = static_cast<T>(width * (z+1) + (x+1));
+			const T i3 = static_cast<T>(width *  z    + (x+1));
+
+			if( winding == anti_diagonal )
+			{
+				list[i++] = i0; list[i++] = i1; list[i++] = i3;
+				list[i++] = i1; list[i++] = i2; list[i++] = i3;
+			}
+			else
+			{
+				list[i++] = i0; list[i++] = i1; list[i++] = i2;
+				list[i++] = i0; list[i++] = i2; list[i++] = i3;
+			}
+		}
+	}
+	assert(i == listCount);
+
+	// One strip per row of squares in each band, zig-zagging between
+	// rows z and z+1. Starting on row z gives the anti-diagonal split, 
+	// starting on row z+1 gives the main diagonal, but flips the facing
+	// of every triangle, so that case leads with a degenerate to fix 
+	// the parity.
+	strip.clear();
+	for(unsigned int x0 = 0; x0 < (width - 1); x0 += bandWidth)
+	{
+		const unsigned int x1 = std::min(x0 + bandWidth, width - 1);
+		for(unsigned int z = 0; z < (height - 1); ++z)
+		{
+			if( !strip.empty() )
+				strip.push_back(static_cast<T>(restartIndex));
+
+			for(unsigned int x = x0; x <= x1; ++x)
+			{
+				const T top    = static_cast<T>(width *  z    + x);
+				const T bottom = static_cast<T>(width * (z+1) + x);
+
+				if( winding == anti_diagonal )
+				{
+					strip.push_back(top);
+					strip.push_back(bottom);
+				}
+				else
+				{
+					if( x == x0 ) 
+						strip.push_back(bottom);
+					strip.push_back(bottom);
+					strip.push_back(top);
+				}
+			}
+		}
+	}
+	stripCount = strip.size();
+
+	listStats = vertexcache::measure(&list[0], listCount);
+}
+
+void GridIndices::draw( const unsigned int mode ) const
+{
+	if( mode == GL_TRIANGLES && GLEE_NV_primitive_restart )
+	{
+		glEnableClientState(GL_PRIMITIVE_RESTART_NV);
+		glPrimitiveRestartIndexNV(restartIndex);
+		glDrawElements(GL_TRIANGLE_STRIP, stripCount, type, stripData());
+		glDisableClientState(GL_PRIMITIVE_RESTART_NV);
+	}
+	else
+		glDrawElements(mode, listCount, type, listData());
+}
+
+const void* GridIndices::listData() const
+{
+	return shortIndices ? static_cast<const void*>(&list16[0])
+						: static_cast<const void*>(&list32[0]);
+}
+
+const void* GridIndices::stripData() const
+{
+	return shortIndices ? static_cast<const void*>(&strip16[0])
+						: static_cast<const void*>(&strip32[0]);
+}
+
+
+bool GridIndexCache::Key::operator<( const Key& other ) const
+{
+	if( width  != other.width  ) return width  < other.width;
+	if( height != other.height ) return height < other.height;
+	return winding < other.winding;
+}
+
+GridIndexCache::~GridIndexCache()
+{
+	for each(auto grid in grids)
+		delete grid.second;
+	grids.clear();
+}
+
+const GridIndices& GridIndexCache::getIndices( const unsigned int width
+											 , const unsigned int height
+											 , const GridIndices::Winding winding )
+{
+	const Key key = { width, height, winding };
+
+	KeyIndicesMap::iterator it = grids.find(key);
+	if( it != grids.end() )
+		return *it->second;
+
+	GridIndices *indices = new GridIndices(width, height, winding);
+	grids[key] = indices;
+
+	std::stringstream ss;
+	const vertexcache::Stats& stats = indices->getListStats();
+	ss << "Generated grid indices " << width << "x" << height 
+	   << " (" << (indices->getType() == GL_UNSIGNED_SHORT ? 16 : 32) << " bit)"
+	   << ", vertex cache ACMR " << stats.acmr << " ATVR " << stats.atvr;
+	Log(ss);
+
+	return *indices;
+}
@@ -0,0 +1,139 @@
+#pragma once
+/************************************************************************/
+/* GridIndices
+/* -----------
+/* Shared index buffers for regular grids of vertices, 
+/* cached by grid dimensions and triangulation
+/************************************************************************/
+#include "VertexCache.h"
+
+#include <map>
+#include <vector>
+
+
+class GridIndices
+{
+public:
+	// Both layouts produce triangles with the same facing,
+	// they differ in which diagonal splits each grid square
+	enum Winding
+	{
+		// Split (x,z+1)-(x+1,z), as generated by Mesh
+		anti_diagonal, 
+		// Split (x,z)-(x+1,z+1), as generated by Fluid
+		main_diagonal
+	};
+
+	// Squares across each band of columns the indices are ordered in
+	static const unsigned int bandWidth = vertexcache::defaultCacheSize / 2 - 2;
+
+private:
+	unsigned int width;
+	unsigned int height;
+	Winding      winding;
+
+	// GL_UNSIGNED_SHORT when every vertex fits, else GL_UNSIGNED_INT
+	unsigned int type;
+	unsigned int restartIndex;
+	bool         shortIndices;
+
+	unsigned int listCount;
+	unsigned int stripCount;
+
+	// The list form replayed through a simulated vertex cache
+	vertexcache::Stats listStats;
+
+	// Only the set matching 'type' is populated
+	std::vector<unsigned short> list16, strip16;
+	std::vector<unsigned int>   list32, strip32;
+
+public:
+	GridIndices( const unsigned int width
+			   , const unsigned int height
+			   , const Winding winding );
+
+	// Draw the grid, as triangle strips joined by primitive restart 
+	// when the driver supports it, otherwise as a triangle list.
+	// Modes other than GL_TRIANGLES always draw the list form.
+	void draw(const unsigned int mode) const;
+
+	// Triangle list form
+	const void*  listData()  const;
+	unsigned int listSize()  const;
+	// Triangle strip form, one strip per row of grid squares in each
+	// band of columns, separated by restartIndex
+	const void*  stripData() const;
+	unsigned int stripSize() const;
+
+	// The ith index of the triangle list form
+	unsigned int operator[](const unsigned int i) const;
+
+	unsigned int getType()         const;
+	unsigned int getRestartIndex() const;
+	unsigned int getWidth()        const;
+	unsigned int getHeight()       const;
+	Winding      getWinding()      const;
+	unsigned int getNumTriangles() const;
+	const vertexcache::Stats& getListStats() const;
+
+private:
+	template<typename T> 
+	void build(std::vector<T>& list, std::vector<T>& strip);
+};
+
+inline unsigned int GridIndices::operator[](const unsigned int i) const
+{
+	return shortIndices ? list16[i] : list32[i];
+}
+
+inline unsigned int GridIndices::listSize()        const { return listCount; }
+inline unsigned int GridIndices::stripSize()       const { return stripCount; }
+inline unsigned int GridIndices::getType()         const { return type; }
+inline unsigned int GridIndices::getRestartIndex() const { return restartIndex; }
+inline unsigned int GridIndices::getWidth()        const { return width; }
+inline unsigned int GridIndices::getHeight()       const { return height; }
+inline unsigned int GridIndices::getNumTriangles() const { return listCount / 3; }
+inline GridIndices::Winding GridIndices::getWinding() const { return winding; }
+inline const vertexcache::Stats& GridIndices::getListStats() const { return listStats; }
+
+
+class GridIndexCache
+{
+private:
+	// Key is (width, height, winding)
+	struct Key
+	{
+		unsigned int width;
+		unsigned int height;
+		GridIndices::Winding winding;
+
+		bool operator<(const Key& other) const;
+	};
+	typedef std::map<Key, GridIndices*> KeyIndicesMap;
+
+	KeyIndicesMap grids;
+
+public:
+	// Look up the indices for a grid, generating them on first use.
+	// The returned indices live as long as the cache does.
+	const GridIndices& getIndices( const unsigned int width
+								 , const unsigned int height
+								 , const GridIndices::Winding winding );
+
+	// Class is singleton, instance is accessed through GridIndexCache::get()
+	static GridIndexCache& get() { static GridIndexCache c; return c; }
+
+private:
+	GridIndexCache() { }
+	~GridIndexCache();
+	// Singletons don't implement these...
+	GridIndexCache(const GridIndexCache& other);
+	GridIndexCache& operator=(const GridIndexCache& other);
+};
+
+inline const GridIndices& GetGridIndices( const unsigned int width
+										, const unsigned int height
+										, const GridIndices::Winding winding )
+{
+	return GridIndexCache::get().getIndices(width, height, winding);
+}
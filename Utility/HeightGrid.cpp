@@ -0,0 +1,156 @@
+/************************************************************************/
+/* HeightGrid
+/* ----------
+/* A contiguous, row-major grid of height values
+/************************************************************************/
+#include "HeightGrid.h"
+#include "Parallel.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <vector>
+
+
+namespace
+{
+	// Repeated 3 tap box passes are the same as one pass with the 
+	// coefficients of (1 + x + x^2)^n, normalized. 
+	std::vector<float> boxKernel(const unsigned int iterations)
+	{
+		std::vector<double> taps(1, 1.0);
+		for(unsigned int i = 0; i < iterations; ++i)
+		{
+			std::vector<double> next(taps.size() + 2, 0.0);
+			for(unsigned int j = 0; j < taps.size(); ++j)
+			{
+				next[j]     += taps[j];
+				next[j + 1] += taps[j];
+				next[j + 2] += taps[j];
+			}
+			taps.swap(next);
+		}
+
+		double sum = 0.0;
+		for each(auto t in taps)
+			sum += t;
+
+		std::vector<float> kernel(taps.size());
+		for(unsigned int j = 0; j < taps.size(); ++j)
+			kernel[j] = static_cast<float>(taps[j] / sum);
+		return kernel;
+	}
+
+	// Rows per worker large enough to be worth a thread
+	unsigned int rowGrain(const unsigned int width, const unsigned int taps)
+	{
+		return std::max(1u, 65536u / std::max(1u, width * taps));
+	}
+}
+
+
+HeightGrid::HeightGrid()
+	: width(0)
+	, height(0)
+	, heights()
+{ }
+
+HeightGrid::HeightGrid( const unsigned int width
+					  , const unsigned int height
+					  , const float value )
+	: width(width)
+	, height(height)
+	, heights(width * height, value)
+{ }
+
+void HeightGrid::resize( const unsigned int width
+					   , const unsigned int height
+					   , const float value )
+{
+	this->width  = width;
+	this->height = height;
+	heights.assign(width * height, value);
+}
+
+void HeightGrid::readHeights( const glm::vec3 *vertices )
+{
+	assert(vertices != nullptr);
+	for(unsigned int i = 0; i < heights.size(); ++i)
+		heights[i] = vertices[i].y;
+}
+
+void HeightGrid::writeHeights( glm::vec3 *vertices ) const
+{
+	assert(vertices != nullptr);
+	for(unsigned int i = 0; i < heights.size(); ++i)
+		vertices[i].y = heights[i];
+}
+
+void HeightGrid::smooth( const unsigned int iterations )
+{
+	if( iterations == 0 || width < 3 || height < 3 )
+		return;
+
+	const std::vector<float> kernel(boxKernel(iterations));
+	const int radius = static_cast<int>(iterations);
+	const int w = static_cast<int>(width);
+	const int h = static_cast<int>(height);
+
+	// Reads past the edges clamp to the nearest sample
+	const float *src = &heights[0];
+	std::vector<float> pass(heights.size());
+	float *tmp = &pass[0];
+	const float *k = &kernel[0];
+
+	// Horizontal pass, heights -> pass
+	auto horizontal = [=](const unsigned int begin, const unsigned int end)
+	{
+		for(int z = begin; z < static_cast<int>(end); ++z)
+		{
+			const float *in  = src + z * w;
+			float       *out = tmp + z * w;
+
+			for(int x = 0; x < w; ++x)
+			{
+				float sum = 0.f;
+				if( x >= radius && x + radius < w )
+				{
+					const float *window = in + x - radius;
+					for(int t = 0; t <= 2 * radius; ++t)
+						sum += k[t] * window[t];
+				}
+				else
+				{
+					for(int t = -radius; t <= radius; ++t)
+						sum += k[t + radius] * in[std::min(std::max(x + t, 0), w - 1)];
+				}
+				out[x] = sum;
+			}
+		}
+	};
+	parallel::forRange(0, height, horizontal, rowGrain(width, kernel.size()));
+
+	// Vertical pass, pass -> heights, accumulating whole rows at a time.
+	// The outer border keeps its original values.
+	float *dst = &heights[0];
+	auto vertical = [=](const unsigned int begin, const unsigned int end)
+	{
+		std::vector<float> acc(w);
+		for(int z = std::max(1, static_cast<int>(begin)); z < std::min(h - 1, static_cast<int>(end)); ++z)
+		{
+			std::fill(acc.begin(), acc.end(), 0.f);
+			for(int t = -radius; t <= radius; ++t)
+			{
+				const float *in = tmp + std::min(std::max(z + t, 0), h - 1) * w;
+				const float weight = k[t + radius];
+				for(int x = 1; x < w - 1; ++x)
+					acc[x] += weight * in[x];
+			}
+
+			float *out = dst + z * w;
+			for(int x = 1; x < w - 1; ++x)
+				out[x] = acc[x];
+		}
+	};
+	parallel::forRange(0, height, vertical, rowGrain(width, kernel.size()));
+}
@@ -0,0 +1,86 @@
+#pragma once
+/************************************************************************/
+/* HeightGrid
+/* ----------
+/* A contiguous, row-major grid of height values
+/************************************************************************/
+#include <glm/glm.hpp>
+
+#include <cassert>
+#include <vector>
+
+
+class HeightGrid
+{
+private:
+	unsigned int width;
+	unsigned int height;
+	std::vector<float> heights;
+
+public:
+	// Create an empty grid
+	HeightGrid();
+	// Create a grid of the specified size, filled with value
+	HeightGrid( const unsigned int width
+			  , const unsigned int height
+			  , const float value = 0.f );
+
+	// Resize the grid, existing values are not preserved
+	void resize( const unsigned int width
+			   , const unsigned int height
+			   , const float value = 0.f );
+
+	// Copy y values from, or back to, a matching row-major vertex grid
+	void readHeights (const glm::vec3 *vertices);
+	void writeHeights(glm::vec3 *vertices) const;
+
+	// Apply the given number of 3x3 box filter passes as a single
+	// separable kernel of width 2 * iterations + 1. Every pass reads 
+	// the previous result, never a half-updated neighbor, and values 
+	// on the outer border are left unchanged.
+	void smooth(const unsigned int iterations = 1);
+
+	// Unchecked access, asserts in debug builds
+	float*       row(const unsigned int z);
+	const float* row(const unsigned int z) const;
+	float&       at (const unsigned int x, const unsigned int z);
+	float        at (const unsigned int x, const unsigned int z) const;
+
+	float*       data();
+	const float* data() const;
+
+	unsigned int getWidth()  const;
+	unsigned int getHeight() const;
+	unsigned int getSize()   const;
+};
+
+
+inline float* HeightGrid::row(const unsigned int z)
+{
+	assert(z < height);
+	return &heights[z * width];
+}
+
+inline const float* HeightGrid::row(const unsigned int z) const
+{
+	assert(z < height);
+	return &heights[z * width];
+}
+
+inline float& HeightGrid::at(const unsigned int x, const unsigned int z)
+{
+	assert(x < width && z < height);
+	return heights[z * width + x];
+}
+
+inline float HeightGrid::at(const unsigned int x, const unsigned int z) const
+{
+	assert(x < width && z < height);
+	return heights[z * width + x];
+}
+
+inline float*       HeightGrid::data()            { return heights.empty() ? nullptr : &heights[0]; }
+inline const float* HeightGrid::data()      const { return heights.empty() ? nullptr : &heights[0]; }
+inline unsigned int HeightGrid::getWidth()  const { return width; }
+inline unsigned int HeightGrid::getHeight() const { return height; }
+inline unsigned int HeightGrid::getSize()   const { return heights.size(); }
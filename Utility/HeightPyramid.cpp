@@ -0,0 +1,307 @@
+/************************************************************************/
+/* HeightPyramid
+/* -------------
+/* Min/max mip levels over the squares of a HeightGrid, used to
+/* march rays across the grid while skipping the empty space above
+/* the surface
+/************************************************************************/
+#include "HeightPyramid.h"
+#include "Parallel.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+
+using namespace glm;
+
+
+namespace
+{
+	// Narrow [tEnter, tExit] to where origin + t * direction lies
+	// in [lo, hi] along one axis, false if it never does
+	bool clipSlab( const float origin, const float direction
+				 , const float lo, const float hi
+				 , float& tEnter, float& tExit )
+	{
+		if( direction == 0.f )
+			return (origin >= lo && origin <= hi);
+
+		float t0 = (lo - origin) / direction;
+		float t1 = (hi - origin) / direction;
+		if( t0 > t1 )
+			std::swap(t0, t1);
+
+		tEnter = std::max(tEnter, t0);
+		tExit  = std::min(tExit,  t1);
+		return (tEnter <= tExit);
+	}
+}
+
+
+HeightPyramid::HeightPyramid()
+	: grid(nullptr)
+	, levels()
+{ }
+
+void HeightPyramid::build( const HeightGrid& grid )
+{
+	this->grid = &grid;
+	levels.clear();
+	if( grid.getWidth() < 2 || grid.getHeight() < 2 )
+		return;
+
+	unsigned int w = grid.getWidth()  - 1;
+	unsigned int h = grid.getHeight() - 1;
+	for(;;)
+	{
+		levels.push_back(Level());
+		levels.back().width  = w;
+		levels.back().height = h;
+		levels.back().range.resize(w * h);
+
+		if( w == 1 && h == 1 )
+			break;
+		w = (w + 1) / 2;
+		h = (h + 1) / 2;
+	}
+
+	for(unsigned int level = 0; level < levels.size(); ++level)
+		buildLevel(level, 0, 0, levels[level].width - 1, levels[level].height - 1);
+}
+
+void HeightPyramid::update( const unsigned int minx, const unsigned int minz
+						  , const unsigned int maxx, const unsigned int maxz )
+{
+	if( levels.empty() || minx > maxx || minz > maxz )
+		return;
+
+	// A grid value is a corner of the squares on either side of it
+	unsigned int x0 = (minx > 0) ? minx - 1 : 0;
+	unsigned int z0 = (minz > 0) ? minz - 1 : 0;
+	unsigned int x1 = std::min(maxx, levels[0].width  - 1);
+	unsigned int z1 = std::min(maxz, levels[0].height - 1);
+	if( x0 > x1 || z0 > z1 )
+		return;
+
+	for(unsigned int level = 0; level < levels.size(); ++level)
+	{
+		buildLevel(level, x0, z0, x1, z1);
+		x0 /= 2; z0 /= 2;
+		x1 /= 2; z1 /= 2;
+	}
+}
+
+void HeightPyramid::buildLevel( const unsigned int level
+							  , const unsigned int minx, const unsigned int minz
+							  , const unsigned int maxx, const unsigned int maxz )
+{
+	Level& out = levels[level];
+
+	if( level == 0 )
+	{
+		for(unsigned int z = minz; z <= maxz; ++z)
+		{
+			const float *row0 = grid->row(z);
+			const float *row1 = grid->row(z + 1);
+			vec2 *range = &out.range[z * out.width];
+			for(unsigned int x = minx; x <= maxx; ++x)
+			{
+				range[x].x = std::min(std::min(row0[x], row0[x + 1]), std::min(row1[x], row1[x + 1]));
+				range[x].y = std::max(std::max(row0[x], row0[x + 1]), std::max(row1[x], row1[x + 1]));
+			}
+		}
+		return;
+	}
+
+	// Each node covers up to 2x2 nodes of the level below
+	const Level& in = levels[level - 1];
+	for(unsigned int z = minz; z <= maxz; ++z)
+	for(unsigned int x = minx; x <= maxx; ++x)
+	{
+		vec2 range(in.range[(2 * z) * in.width + 2 * x]);
+		for(unsigned int cz = 2 * z; cz <= 2 * z + 1 && cz < in.height; ++cz)
+		for(unsigned int cx = 2 * x; cx <= 2 * x + 1 && cx < in.width;  ++cx)
+		{
+			const vec2& child = in.range[cz * in.width + cx];
+			range.x = std::min(range.x, child.x);
+			range.y = std::max(range.y, child.y);
+		}
+		out.range[z * out.width + x] = range;
+	}
+}
+
+bool HeightPyramid::intersect( const Ray& ray, float& distance ) const
+{
+	if( levels.empty() )
+		return false;
+
+	const vec3& o = ray.origin;
+	const vec3& d = ray.direction;
+	const float inf = std::numeric_limits<float>::infinity();
+
+	// Clip to the footprint of the grid
+	float t     = 0.f;
+	float tExit = ray.maxDistance;
+	if( !clipSlab(o.x, d.x, 0.f, static_cast<float>(levels[0].width),  t, tExit)
+	 || !clipSlab(o.z, d.z, 0.f, static_cast<float>(levels[0].height), t, tExit) )
+		return false;
+
+	const float invX = (d.x != 0.f) ? 1.f / d.x : 0.f;
+	const float invZ = (d.z != 0.f) ? 1.f / d.z : 0.f;
+	const int stepX = (d.x > 0.f) ? 1 : -1;
+	const int stepZ = (d.z > 0.f) ? 1 : -1;
+
+	// Start from the single node at the top and work down to the
+	// squares only where the ray comes within a node's height range
+	unsigned int level = levels.size() - 1;
+	int cx = 0;
+	int cz = 0;
+	for(;;)
+	{
+		const Level& L = levels[level];
+		const float size = static_cast<float>(1u << level);
+
+		const float tx = (d.x > 0.f) ? ((cx + 1) * size - o.x) * invX
+					   : (d.x < 0.f) ? (cx * size - o.x) * invX : inf;
+		const float tz = (d.z > 0.f) ? ((cz + 1) * size - o.z) * invZ
+					   : (d.z < 0.f) ? (cz * size - o.z) * invZ : inf;
+		const float tNext = std::max(t, std::min(tx, tz));
+		const float t1    = std::min(tNext, tExit);
+
+		const vec2& range = L.range[cz * L.width + cx];
+		const float y0 = o.y + d.y * t;
+		const float y1 = o.y + d.y * t1;
+		if( std::min(y0, y1) <= range.y )
+		{
+			// Already under the lowest point of the node
+			if( y0 < range.x )
+			{
+				distance = t;
+				return true;
+			}
+
+			if( level > 0 )
+			{
+				// Rounding can pick the neighboring child, which just 
+				// costs a zero length step across to the right one
+				const Level& child = levels[--level];
+				const float half = 0.5f * size;
+				const vec3 p(o + d * t);
+				cx = 2 * cx + ((p.x >= (2 * cx + 1) * half) ? 1 : 0);
+				cz = 2 * cz + ((p.z >= (2 * cz + 1) * half) ? 1 : 0);
+				cx = std::min(cx, static_cast<int>(child.width)  - 1);
+				cz = std::min(cz, static_cast<int>(child.height) - 1);
+				continue;
+			}
+
+			if( intersectSquare(ray, cx, cz, t, t1, distance) )
+				return true;
+		}
+
+		if( tNext >= tExit )
+			return false;
+
+		const int parentX = cx / 2;
+		const int parentZ = cz / 2;
+
+		t = tNext;
+		if( tx < tz ) cx += stepX;
+		else          cz += stepZ;
+		if( cx < 0 || cz < 0 || cx >= static_cast<int>(L.width) || cz >= static_cast<int>(L.height) )
+			return false;
+
+		// Try the coarser node around the new one first, but only once 
+		// the step leaves the old parent, it was already found too high
+		if( level + 1 < levels.size() && (cx / 2 != parentX || cz / 2 != parentZ) )
+		{
+			++level;
+			cx /= 2;
+			cz /= 2;
+		}
+	}
+}
+
+void HeightPyramid::intersect( const Ray *rays
+							 , const unsigned int count
+							 , float *distances ) const
+{
+	assert(count == 0 || (rays != nullptr && distances != nullptr));
+
+	auto cast = [=](const unsigned int begin, const unsigned int end)
+	{
+		for(unsigned int i = begin; i < end; ++i)
+		{
+			float distance;
+			distances[i] = intersect(rays[i], distance) ? distance : -1.f;
+		}
+	};
+	parallel::forRange(0, count, cast, 4096);
+}
+
+bool HeightPyramid::intersectSquare( const Ray& ray
+								   , const unsigned int x, const unsigned int z
+								   , const float t0, const float t1
+								   , float& distance ) const
+{
+	const float *row0 = grid->row(z);
+	const float *row1 = grid->row(z + 1);
+	const float h00 = row0[x], h10 = row0[x + 1];
+	const float h01 = row1[x], h11 = row1[x + 1];
+
+	const vec3& o = ray.origin;
+	const vec3& d = ray.direction;
+
+	// Square coordinates u, v are linear in t, so are the heights 
+	// of each triangle, and so is the ray's height above either one
+	const float u0 = o.x - x;
+	const float v0 = o.z - z;
+	auto above = [&](const float t, const bool lower) -> float
+	{
+		const float u = u0 + d.x * t;
+		const float v = v0 + d.z * t;
+		const float h = lower
+			? h00 + u * (h10 - h00) + v * (h01 - h00)
+			: h11 + (1.f - u) * (h01 - h11) + (1.f - v) * (h10 - h11);
+		return (o.y + d.y * t) - h;
+	};
+
+	// Split the interval where it crosses the anti-diagonal u + v = 1
+	float pieces[3] = { t0, t1, t1 };
+	unsigned int numPieces = 1;
+	const float ds = d.x + d.z;
+	if( ds != 0.f )
+	{
+		const float tm = (1.f - u0 - v0) / ds;
+		if( tm > t0 && tm < t1 )
+		{
+			pieces[1] = tm;
+			numPieces = 2;
+		}
+	}
+
+	for(unsigned int i = 0; i < numPieces; ++i)
+	{
+		const float a = pieces[i];
+		const float b = pieces[i + 1];
+		const float mid = 0.5f * (a + b);
+		const bool lower = (u0 + d.x * mid) + (v0 + d.z * mid) <= 1.f;
+
+		const float fa = above(a, lower);
+		if( fa <= 0.f )
+		{
+			distance = a;
+			return true;
+		}
+
+		const float fb = above(b, lower);
+		if( fb <= 0.f )
+		{
+			distance = a + (b - a) * fa / (fa - fb);
+			return true;
+		}
+	}
+
+	return false;
+}
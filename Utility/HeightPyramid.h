@@ -0,0 +1,79 @@
+#pragma once
+/************************************************************************/
+/* HeightPyramid
+/* -------------
+/* Min/max mip levels over the squares of a HeightGrid, used to
+/* march rays across the grid while skipping the empty space above
+/* the surface
+/************************************************************************/
+#include "HeightGrid.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+
+class HeightPyramid
+{
+public:
+	// A ray in grid space, x and z in grid squares, y in height units
+	struct Ray
+	{
+		glm::vec3 origin;
+		glm::vec3 direction;
+		float maxDistance;     // in multiples of direction, must be finite
+	};
+
+private:
+	struct Level
+	{
+		unsigned int width;
+		unsigned int height;
+		std::vector<glm::vec2> range;   // (min, max) height of each node
+	};
+
+	const HeightGrid *grid;
+	std::vector<Level> levels;   // level 0 has one node per grid square
+
+public:
+	HeightPyramid();
+
+	// Build every level over the grid, which must outlive the pyramid
+	void build(const HeightGrid& grid);
+
+	// Rebuild only the nodes over an inclusive rectangle of grid
+	// values that changed
+	void update( const unsigned int minx, const unsigned int minz
+			   , const unsigned int maxx, const unsigned int maxz );
+
+	// Find the first point along the ray at or below the surface 
+	// drawn by Mesh (each square split on its anti-diagonal), 
+	// distance is set in multiples of the ray direction. The grid
+	// is treated as solid below its surface, so a ray coming in
+	// through a side of the grid beneath the edge hits where it enters.
+	bool intersect(const Ray& ray, float& distance) const;
+
+	// Intersect many rays, distances are negative for misses
+	void intersect( const Ray *rays
+				  , const unsigned int count
+				  , float *distances ) const;
+
+	bool         isBuilt()      const;
+	unsigned int getNumLevels() const;
+
+private:
+	void buildLevel( const unsigned int level
+				   , const unsigned int minx, const unsigned int minz
+				   , const unsigned int maxx, const unsigned int maxz );
+
+	// Exact test against the two triangles of one grid square
+	// over the ray interval [t0, t1]
+	bool intersectSquare( const Ray& ray
+						, const unsigned int x, const unsigned int z
+						, const float t0, const float t1
+						, float& distance ) const;
+};
+
+
+inline bool         HeightPyramid::isBuilt()      const { return !levels.empty(); }
+inline unsigned int HeightPyramid::getNumLevels() const { return levels.size(); }
@@ -0,0 +1,211 @@
+/************************************************************************/
+/* HorizonMap
+/* ----------
+/* Per vertex horizon elevations of a HeightGrid in eight directions,
+/* and the ambient occlusion they give, baked once and kept up to
+/* date as the heights change
+/************************************************************************/
+#include "HorizonMap.h"
+#include "Parallel.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+using namespace glm;
+
+
+namespace
+{
+	// One grid step toward each direction
+	const int stepX[HorizonMap::numDirections] = { 1, 1, 0, -1, -1, -1,  0,  1 };
+	const int stepZ[HorizonMap::numDirections] = { 0, 1, 1,  1,  0, -1, -1, -1 };
+
+	// A vertex passed by a sweep, at index i along the line
+	struct HullPoint
+	{
+		int i;
+		float h;
+	};
+
+	bool onGrid(const int x, const int z, const unsigned int width, const unsigned int height)
+	{
+		return (x >= 0 && z >= 0 && x < (int)width && z < (int)height);
+	}
+
+	// The far end of every line of a direction is a border vertex
+	// with no neighbor toward the direction
+	void lineStarts( const unsigned int direction
+				   , const unsigned int width, const unsigned int height
+				   , std::vector<ivec2>& starts )
+	{
+		const int dx = stepX[direction];
+		const int dz = stepZ[direction];
+
+		starts.clear();
+		for(unsigned int z = 0; z < height; ++z)
+		{
+			// Inner rows only have two border vertices
+			const unsigned int xstep = (z == 0 || z == height - 1) ? 1 : std::max(width - 1, 1u);
+			for(unsigned int x = 0; x < width; x += xstep)
+			{
+				if( !onGrid(x + dx, z + dz, width, height) )
+					starts.push_back(ivec2(x, z));
+			}
+		}
+	}
+}
+
+
+HorizonMap::HorizonMap()
+	: width(0)
+	, height(0)
+	, spacing(1.f)
+	, horizons()
+	, ambient()
+{ }
+
+void HorizonMap::bake( const HeightGrid& grid, const float spacing )
+{
+	width  = grid.getWidth();
+	height = grid.getHeight();
+	this->spacing = spacing;
+
+	const unsigned int numVertices = width * height;
+	horizons.assign(numVertices * numDirections, 0);
+	ambient.assign(numVertices, 255);
+	if( numVertices == 0 )
+		return;
+
+	// Lines of one direction share no vertices, so they can be
+	// swept at the same time
+	std::vector<ivec2> starts;
+	for(unsigned int d = 0; d < numDirections; ++d)
+	{
+		lineStarts(d, width, height, starts);
+		parallel::forRange(0, starts.size(), [&](unsigned int begin, unsigned int end)
+		{
+			for(unsigned int i = begin; i < end; ++i)
+				sweepLine(grid, d, starts[i].x, starts[i].y, nullptr);
+		}, 16);
+	}
+
+	parallel::forRange(0, height, [&](unsigned int begin, unsigned int end)
+	{
+		for(unsigned int i = begin * width; i < end * width; ++i)
+			ambient[i] = computeAmbient(i);
+	}, 16);
+}
+
+void HorizonMap::update( const HeightGrid& grid
+					   , const unsigned int minx, const unsigned int minz
+					   , const unsigned int maxx, const unsigned int maxz
+					   , std::vector<unsigned int>& changed )
+{
+	assert(isBaked() && grid.getWidth() == width && grid.getHeight() == height);
+	assert(minx <= maxx && maxx < width && minz <= maxz && maxz < height);
+
+	std::vector<unsigned int> moved;
+	for(unsigned int d = 0; d < numDirections; ++d)
+	{
+		const int dx = stepX[d];
+		const int dz = stepZ[d];
+
+		// Every line crossing the rectangle leaves it at exactly one
+		// vertex, from which its far end is found by walking on
+		for(unsigned int z = minz; z <= maxz; ++z)
+		for(unsigned int x = minx; x <= maxx; ++x)
+		{
+			int ex = x + dx;
+			int ez = z + dz;
+			if( ex >= (int)minx && ex <= (int)maxx && ez >= (int)minz && ez <= (int)maxz )
+				continue;
+
+			int sx = x;
+			int sz = z;
+			while( onGrid(ex, ez, width, height) )
+			{
+				sx = ex;
+				sz = ez;
+				ex += dx;
+				ez += dz;
+			}
+			sweepLine(grid, d, sx, sz, &moved);
+		}
+	}
+
+	std::sort(moved.begin(), moved.end());
+	moved.erase(std::unique(moved.begin(), moved.end()), moved.end());
+	for each(auto vertex in moved)
+	{
+		const unsigned char value = computeAmbient(vertex);
+		if( value != ambient[vertex] )
+		{
+			ambient[vertex] = value;
+			changed.push_back(vertex);
+		}
+	}
+}
+
+void HorizonMap::sweepLine( const HeightGrid& grid
+						  , const unsigned int direction
+						  , int x, int z
+						  , std::vector<unsigned int> *moved )
+{
+	const int dx = -stepX[direction];
+	const int dz = -stepZ[direction];
+	const float step = (dx != 0 && dz != 0) ? spacing * sqrt(2.f) : spacing;
+
+	// Upper hull of the heights passed so far, the horizon of the
+	// next vertex is where its line of sight touches the hull
+	std::vector<HullPoint> hull;
+	for(int i = 0; onGrid(x, z, width, height); ++i, x += dx, z += dz)
+	{
+		const float h = grid.at(x, z);
+
+		// Drop hull points that this vertex hides from every vertex
+		// behind it, what's left rises toward the tangent point
+		while( hull.size() >= 2 )
+		{
+			const HullPoint& a = hull[hull.size() - 2];
+			const HullPoint& b = hull[hull.size() - 1];
+			if( (a.h - h) * (i - b.i) >= (b.h - h) * (i - a.i) )
+				hull.pop_back();
+			else
+				break;
+		}
+
+		unsigned char value = 0;
+		if( !hull.empty() && hull.back().h > h )
+		{
+			const float rise = hull.back().h - h;
+			const float run  = (i - hull.back().i) * step;
+			value = static_cast<unsigned char>(255.f * rise / sqrt(rise * rise + run * run) + 0.5f);
+		}
+
+		const unsigned int vertex = z * width + x;
+		unsigned char& slot = horizons[vertex * numDirections + direction];
+		if( moved != nullptr && slot != value )
+			moved->push_back(vertex);
+		slot = value;
+
+		HullPoint point = { i, h };
+		hull.push_back(point);
+	}
+}
+
+unsigned char HorizonMap::computeAmbient( const unsigned int vertex ) const
+{
+	// A cosine weighted sky above a horizon at elevation e lets
+	// through 1 - sin^2(e) of the light of that slice
+	const unsigned char *h = &horizons[vertex * numDirections];
+	float sum = 0.f;
+	for(unsigned int d = 0; d < numDirections; ++d)
+	{
+		const float s = h[d] / 255.f;
+		sum += 1.f - s * s;
+	}
+	return static_cast<unsigned char>(255.f * sum / numDirections + 0.5f);
+}
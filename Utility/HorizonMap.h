@@ -0,0 +1,91 @@
+#pragma once
+/************************************************************************/
+/* HorizonMap
+/* ----------
+/* Per vertex horizon elevations of a HeightGrid in eight directions,
+/* and the ambient occlusion they give, baked once and kept up to
+/* date as the heights change
+/************************************************************************/
+#include "HeightGrid.h"
+
+#include <vector>
+
+
+class HorizonMap
+{
+public:
+	// Direction d looks toward angle d * 45 degrees from +x to +z,
+	// so every direction follows grid rows, columns or diagonals
+	// and the horizon is found on the grid vertices themselves
+	static const unsigned int numDirections = 8;
+
+private:
+	unsigned int width;
+	unsigned int height;
+	float spacing;     // ground distance between neighboring vertices
+
+	// Sine of the horizon elevation, 0 for an open horizon,
+	// quantized to a byte, numDirections per vertex
+	std::vector<unsigned char> horizons;
+	// Fraction of the sky each vertex sees, quantized to a byte
+	std::vector<unsigned char> ambient;
+
+public:
+	HorizonMap();
+
+	// Find the horizons of every vertex, sweeping the lines of each
+	// direction in parallel, spacing is the ground distance between
+	// neighboring vertices
+	void bake(const HeightGrid& grid, const float spacing);
+
+	// Sweep again the lines that cross an inclusive rectangle of
+	// heights that changed, which is every vertex whose horizon
+	// can have moved, and add the vertices whose ambient term
+	// changed to the changed list
+	void update( const HeightGrid& grid
+			   , const unsigned int minx, const unsigned int minz
+			   , const unsigned int maxx, const unsigned int maxz
+			   , std::vector<unsigned int>& changed );
+
+	// Sine of the horizon elevation looking toward a direction
+	float getHorizon(const unsigned int x, const unsigned int z, const unsigned int direction) const;
+	// Cosine weighted fraction of the sky seen, 1 on open ground
+	float getAmbient(const unsigned int x, const unsigned int z) const;
+	float getAmbient(const unsigned int vertex) const;
+
+	bool isBaked() const;
+	unsigned int getWidth()  const;
+	unsigned int getHeight() const;
+
+private:
+	// Walk one line against a direction from its far end, keeping the
+	// upper hull of the heights passed so the horizon of each vertex
+	// is found in amortized constant time. Vertices whose horizon
+	// changed are added to moved when it's not null.
+	void sweepLine( const HeightGrid& grid
+				  , const unsigned int direction
+				  , int x, int z
+				  , std::vector<unsigned int> *moved );
+	// Fold a vertex's horizons into its ambient term
+	unsigned char computeAmbient(const unsigned int vertex) const;
+};
+
+
+inline float HorizonMap::getHorizon(const unsigned int x, const unsigned int z, const unsigned int direction) const
+{
+	return horizons[(z * width + x) * numDirections + direction] / 255.f;
+}
+
+inline float HorizonMap::getAmbient(const unsigned int x, const unsigned int z) const
+{
+	return getAmbient(z * width + x);
+}
+
+inline float HorizonMap::getAmbient(const unsigned int vertex) const
+{
+	return ambient[vertex] / 255.f;
+}
+
+inline bool HorizonMap::isBaked() const { return !ambient.empty(); }
+inline unsigned int HorizonMap::getWidth()  const { return width; }
+inline unsigned int HorizonMap::getHeight() const { return height; }
@@ -0,0 +1,110 @@
+/************************************************************************/
+/* MappedFile
+/* ----------
+/* A read-only view of a whole file mapped into memory
+/************************************************************************/
+#include "MappedFile.h"
+
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+
+MappedFile::MappedFile()
+	: bytes(nullptr)
+	, length(0)
+	, fileHandle(nullptr)
+	, mapHandle(nullptr)
+{ }
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+bool MappedFile::open( const std::string& filename )
+{
+	close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ
+							, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if( file == INVALID_HANDLE_VALUE )
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if( !GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0 
+	 || static_cast<unsigned long long>(fileSize.QuadPart) > static_cast<std::size_t>(-1) )
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if( mapping == nullptr )
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	const void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if( view == nullptr )
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	fileHandle = file;
+	mapHandle  = mapping;
+	bytes  = static_cast<const unsigned char*>(view);
+	length = static_cast<std::size_t>(fileSize.QuadPart);
+#else
+	const int fd = ::open(filename.c_str(), O_RDONLY);
+	if( fd < 0 )
+		return false;
+
+	struct stat info;
+	if( fstat(fd, &info) != 0 || info.st_size <= 0 )
+	{
+		::close(fd);
+		return false;
+	}
+
+	// The mapping holds its own reference, so the descriptor can go
+	void *view = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if( view == MAP_FAILED )
+		return false;
+
+	bytes  = static_cast<const unsigned char*>(view);
+	length = static_cast<std::size_t>(info.st_size);
+#endif
+
+	return true;
+}
+
+void MappedFile::close()
+{
+	if( bytes == nullptr )
+		return;
+
+#ifdef _WIN32
+	UnmapViewOfFile(bytes);
+	CloseHandle(static_cast<HANDLE>(mapHandle));
+	CloseHandle(static_cast<HANDLE>(fileHandle));
+#else
+	munmap(const_cast<unsigned char*>(bytes), length);
+#endif
+
+	bytes      = nullptr;
+	length     = 0;
+	fileHandle = nullptr;
+	mapHandle  = nullptr;
+}
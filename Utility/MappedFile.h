@@ -0,0 +1,44 @@
+#pragma once
+/************************************************************************/
+/* MappedFile
+/* ----------
+/* A read-only view of a whole file mapped into memory
+/************************************************************************/
+#include <cstddef>
+#include <string>
+
+
+class MappedFile
+{
+private:
+	const unsigned char *bytes;
+	std::size_t length;
+
+	// Windows keeps the file and mapping handles open for the view
+	void *fileHandle;
+	void *mapHandle;
+
+public:
+	MappedFile();
+	~MappedFile();
+
+	// Map the named file, replacing any previous mapping, 
+	// false if it can't be opened or is empty
+	bool open(const std::string& filename);
+	// Unmap the file, invalidating every pointer into it
+	void close();
+
+	bool isOpen() const;
+	const unsigned char* data() const;
+	std::size_t size() const;
+
+private:
+	// Non-copyable
+	MappedFile(const MappedFile& other);
+	void operator=(const MappedFile& other);
+};
+
+
+inline bool                 MappedFile::isOpen() const { return bytes != nullptr; }
+inline const unsigned char* MappedFile::data()   const { return bytes; }
+inline std::size_t          MappedFile::size()   const { return length; }
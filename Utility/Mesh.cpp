@@ -7,6 +7,8 @@
 
 #include "Mesh.h"
 #include "Logger.h"
+#include "Parallel.h"
+#include "HeightGrid.h"
 #include "../Core/ImageManager.h"
 
 #include <glm/glm.hpp>
@@ -17,6 +19,8 @@
 #include <SFML/Graphics.hpp>
 #include <SFML/Graphics/Image.hpp>
 
+#include <algorithm>
+#include <cstddef>
 #include <iostream>
 #include <sstream>
 #include <string>
@@ -27,6 +31,8 @@ using namespace glm;
 
 
 Mesh::Mesh()
+	: listeners()
+	, nextListenerId(1)
 {
 	initialize();
 }
@@ -35,6 +41,8 @@ Mesh::Mesh( const unsigned int width
 		  , const unsigned int height
 		  , const float spread
 		  , const unsigned int elementMode )
+	: listeners()
+	, nextListenerId(1)
 {
 	initialize(width, height, spread, elementMode);
 }
@@ -43,6 +51,8 @@ Mesh::Mesh( const string& imageFileName
 		  , const float spread
 		  , const float heightSpread
 		  , const unsigned int elementMode )
+	: listeners()
+	, nextListenerId(1)
 {
 	initialize(imageFileName, spread, heightSpread, elementMode);
 }
@@ -51,6 +61,8 @@ Mesh::Mesh( const sf::Image& image
 		  , const float spread
 		  , const float heightSpread
 		  , const unsigned int elementMode )
+	: listeners()
+	, nextListenerId(1)
 {
 	initialize(image, spread, heightSpread, elementMode);
 }
@@ -62,72 +74,166 @@ Mesh::~Mesh()
 
 void Mesh::render() const
 {
-	setRenderStates();
+	const ArrayLayout layout(bindArrays());
+	setRenderStates(layout);
 
 	// Draw the mesh ------------------------------
 	glEnableClientState(GL_COLOR_ARRAY);
 	glEnableClientState(GL_VERTEX_ARRAY);
 
-	assert(colors   != nullptr);
-	assert(vertices != nullptr);
-	glColorPointer (4, GL_FLOAT, 0, value_ptr(colors[0]));
-	glVertexPointer(3, GL_FLOAT, 0, value_ptr(vertices[0]));
+	glColorPointer (4, GL_FLOAT, layout.stride, layout.color);
+	glVertexPointer(3, GL_FLOAT, layout.stride, layout.position);
 
 	glActiveTexture(GL_TEXTURE0);
-	assert(indices != nullptr);
-	glDrawElements(mode, numIndices, GL_UNSIGNED_INT, indices);
+	drawElements();
 
 	glDisableClientState(GL_VERTEX_ARRAY);
 	glDisableClientState(GL_COLOR_ARRAY);
 
 	resetRenderStates();
 
+	if( vbo != 0 )
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
 	if( normalsVis )
 		renderNormals();
 }
 
-void Mesh::generateArrayIndices()
+void Mesh::drawElements() const
+{
+	assert(indices != nullptr);
+	indices->draw(mode);
+}
+
+Mesh::ArrayLayout Mesh::bindArrays() const
+{
+	assert(colors   != nullptr);
+	assert(vertices != nullptr);
+	assert(normals  != nullptr);
+
+	ArrayLayout layout;
+
+	if( !GLEE_VERSION_1_5 )
+	{
+		layout.position    = value_ptr(vertices[0]);
+		layout.normal      = value_ptr(normals[0]);
+		layout.color       = value_ptr(colors[0]);
+		layout.texcoord[0] = texcoords.size() > 0 ? texcoords[0] : nullptr;
+		layout.texcoord[1] = texcoords.size() > 1 ? texcoords[1] : nullptr;
+		layout.stride      = 0;
+		return layout;
+	}
+
+	if( vbo == 0 )
+	{
+		glGenBuffers(1, &vbo);
+		glBindBuffer(GL_ARRAY_BUFFER, vbo);
+		glBufferData(GL_ARRAY_BUFFER, numVertices * sizeof(MeshVertex), nullptr, GL_STATIC_DRAW);
+		dirtyBegin = 0;
+		dirtyEnd   = numVertices;
+	}
+	else
+		glBindBuffer(GL_ARRAY_BUFFER, vbo);
+
+	// Only the range touched since the last frame goes over the bus
+	if( dirtyBegin < dirtyEnd )
+	{
+		const unsigned int count = dirtyEnd - dirtyBegin;
+		vector<MeshVertex> packed(count);
+		packVertices(dirtyBegin, count, &packed[0]);
+
+		glBufferSubData(GL_ARRAY_BUFFER
+					  , dirtyBegin * sizeof(MeshVertex)
+					  , count * sizeof(MeshVertex)
+					  , &packed[0]);
+		dirtyBegin = dirtyEnd = 0;
+	}
+
+	// Buffer offsets stand in for pointers while a buffer is bound
+	const char *base = nullptr;
+	layout.position    = base + offsetof(MeshVertex, position);
+	layout.normal      = base + offsetof(MeshVertex, normal);
+	layout.color       = base + offsetof(MeshVertex, color);
+	layout.texcoord[0] = base + offsetof(MeshVertex, texcoord);
+	layout.texcoord[1] = base + offsetof(MeshVertex, texcoord) + sizeof(vec2);
+	layout.stride      = sizeof(MeshVertex);
+	return layout;
+}
+
+void Mesh::packVertices( const unsigned int first
+					   , const unsigned int count
+					   , MeshVertex *out ) const
 {
-	if( indices != nullptr ) 
-		delete[] indices;
+	assert(first + count <= numVertices);
+	assert(out != nullptr);
 
-	indices = new unsigned int[numIndices];
+	const vec2 *layer0 = texcoords.size() > 0 ? texcoords[0] : nullptr;
+	const vec2 *layer1 = texcoords.size() > 1 ? texcoords[1] : nullptr;
 
-	unsigned int i = 0;
+	// Generated layers behave as zero scale and offset when absent
+	TexcoordGen gen0 = { vec2(0.f), vec2(0.f) };
+	TexcoordGen gen1 = gen0;
+	if( texgens.size() > 0 ) gen0 = texgens[0];
+	if( texgens.size() > 1 ) gen1 = texgens[1];
 
-	for(unsigned int z = 0; z < (height - 1); ++z)
-	for(unsigned int x = 0; x < (width  - 1); ++x)
+	unsigned int col = first % width;
+	unsigned int row = first / width;
+	for(unsigned int i = 0, v = first; i < count; ++i, ++v)
 	{
-		const unsigned int i0 = width *  z    +  x;
-		const unsigned int i1 = width * (z+1) +  x;
-		const unsigned int i2 = width * (z+1) + (x+1);
-		const unsigned int i3 = width *  z    + (x+1);
-
-		// First triangle
-		indices[i++] = i0;
-		indices[i++] = i1;
-		indices[i++] = i3;
-
-		// Second triangle
-		indices[i++] = i1;
-		indices[i++] = i2;
-		indices[i++] = i3;
+		const vec2 grid(static_cast<float>(col), static_cast<float>(row));
+
+		MeshVertex& packed(out[i]);
+		packed.position    = vertices[v];
+		packed.normal      = normals[v];
+		packed.color       = colors[v];
+		packed.texcoord[0] = (layer0 != nullptr) ? layer0[v] : grid * gen0.scale + gen0.offset;
+		packed.texcoord[1] = (layer1 != nullptr) ? layer1[v] : grid * gen1.scale + gen1.offset;
+
+		if( ++col >= width )
+		{
+			col = 0;
+			++row;
+		}
 	}
 }
 
+void Mesh::markDirty()
+{
+	dirtyBegin = 0;
+	dirtyEnd   = numVertices;
+}
+
+void Mesh::markDirty( const unsigned int minRow, const unsigned int maxRow )
+{
+	if( minRow > maxRow || minRow >= height )
+		return;
+
+	// Rows are contiguous, so any set of rows widens to one range
+	const unsigned int first = minRow * width;
+	const unsigned int last  = (std::min(maxRow, height - 1) + 1) * width;
+	if( dirtyBegin < dirtyEnd )
+	{
+		dirtyBegin = std::min(dirtyBegin, first);
+		dirtyEnd   = std::max(dirtyEnd, last);
+	}
+	else
+	{
+		dirtyBegin = first;
+		dirtyEnd   = last;
+	}
+}
+
+void Mesh::generateArrayIndices()
+{
+	indices = &GetGridIndices(width, height, GridIndices::anti_diagonal);
+	assert(indices->listSize() == numIndices);
+}
+
 void Mesh::regenerateArrays( const unsigned int w
 						   , const unsigned int h
 						   , const float s )
 {
-	width  = w;
-	height = h;
-	numVertices  = width * height;
-	numTriangles = 2 * (width - 1) * (height - 1);
-	numIndices   = 3 * numTriangles;
-
-	colors    = new vec4[numVertices];
-	vertices  = new vec3[numVertices];
-	normals   = new vec3[numVertices];
+	allocateArrays(w, h);
 
 	for(unsigned int i = 0, x = 0, z = 0; 
 		i < numVertices; ++i)
@@ -146,13 +252,28 @@ void Mesh::regenerateArrays( const unsigned int w
 		}
 	}
 
-	generateArrayIndices();
 	regenerateNormals();
 }
 
+void Mesh::allocateArrays( const unsigned int w, const unsigned int h )
+{
+	width  = w;
+	height = h;
+	numVertices  = width * height;
+	numTriangles = 2 * (width - 1) * (height - 1);
+	numIndices   = 3 * numTriangles;
+
+	colors    = new vec4[numVertices];
+	vertices  = new vec3[numVertices];
+	normals   = new vec3[numVertices];
+
+	generateArrayIndices();
+	markDirty();
+}
+
 void Mesh::dropMesh()
 {
-	if( indices   != nullptr ) delete[] indices;
+	if( vbo != 0 ) glDeleteBuffers(1, &vbo);
 	if( normals   != nullptr ) delete[] normals;
 	if( vertices  != nullptr ) delete[] vertices;
 	if( colors    != nullptr ) delete[] colors;
@@ -160,6 +281,7 @@ void Mesh::dropMesh()
 	for each(auto texcoord in texcoords)
 		delete[] texcoord;
 	texcoords.clear();
+	texgens.clear();
 	textures.clear();
 
 	zeroMembers();
@@ -202,15 +324,7 @@ void Mesh::initialize( const sf::Image& image
 	this->mode   = elementMode;
 	this->spread = spread;
 
-	width  = image.GetWidth();
-	height = image.GetHeight();
-	numVertices  = width * height;
-	numTriangles = 2 * (width - 1) * (height - 1);
-	numIndices   = 3 * numTriangles;
-
-	colors    = new vec4[numVertices];
-	vertices  = new vec3[numVertices];
-	normals   = new vec3[numVertices];
+	allocateArrays(image.GetWidth(), image.GetHeight());
 
 	for(unsigned int i = 0, x = 0, z = 0; 
 		i < numVertices; ++i)
@@ -243,10 +357,7 @@ void Mesh::initialize( const sf::Image& image
 	}
 
 	// Smooth mesh height values
-	for(int i = 0; i < 20; ++i)
-		smoothHeights();
-
-	generateArrayIndices();
+	smoothHeights(20);
 
 	regenerateNormals();
 }
@@ -258,6 +369,7 @@ void Mesh::zeroMembers()
 	normals      = nullptr;
 	indices      = nullptr;
 	texcoords.clear();
+	texgens.clear();
 	textures.clear();
 	mode         = 0;
 	width        = 0;
@@ -265,6 +377,9 @@ void Mesh::zeroMembers()
 	numVertices  = 0;
 	numTriangles = 0;
 	numIndices   = 0;
+	vbo          = 0;
+	dirtyBegin   = 0;
+	dirtyEnd     = 0;
 	spread       = 0.f;
 	texture      = false;
 	blend        = false;
@@ -273,7 +388,7 @@ void Mesh::zeroMembers()
 	normalsVis   = false;
 }
 
-void Mesh::setRenderStates() const
+void Mesh::setRenderStates( const ArrayLayout& layout ) const
 {
 	// Set texturing state ----------------------
 	if( texture ) 
@@ -282,13 +397,11 @@ void Mesh::setRenderStates() const
 		{
 			assert(textures.size() == texcoords.size());
 			const sf::Image *texture  = textures.front();
-			const glm::vec2 *texcoord = texcoords.front();
 
 			// Enable texture unit 0
 			glActiveTexture(GL_TEXTURE0);
 			glClientActiveTexture(GL_TEXTURE0);
 			glEnable(GL_TEXTURE_2D);
-			glEnableClientState(GL_TEXTURE_COORD_ARRAY);
 
 			texture->Bind();
 
@@ -299,19 +412,17 @@ void Mesh::setRenderStates() const
 			// Set the texture environment to modulate
 			glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
 
-			glTexCoordPointer(2, GL_FLOAT, 0, value_ptr(*texcoord));
+			setTexcoordSource(0, layout);
 
 			// Handle multitexturing
 			if( textures.size() > 1 && multiTexture )
 			{
 				// Just one more for now...
 				const sf::Image *mtexture  = textures[1];
-				const glm::vec2 *mtexcoord = texcoords[1];
 
 				glActiveTexture(GL_TEXTURE1); // GL_TETXTURE0 + ith_texture
 				glClientActiveTexture(GL_TEXTURE1);
 				glEnable(GL_TEXTURE_2D);
-				glEnableClientState(GL_TEXTURE_COORD_ARRAY);
 
 				mtexture->Bind();
 
@@ -341,7 +452,7 @@ void Mesh::setRenderStates() const
 				glTexEnvi(GL_TEXTURE_ENV, GL_OPERAND0_RGB, GL_SRC_COLOR);
 				glTexEnvi(GL_TEXTURE_ENV, GL_OPERAND1_RGB, GL_SRC_COLOR);
 
-				glTexCoordPointer(2, GL_FLOAT, 0, value_ptr(*mtexcoord));
+				setTexcoordSource(1, layout);
 			}
 		}
 	}
@@ -353,8 +464,7 @@ void Mesh::setRenderStates() const
 	{
 		glEnable(GL_LIGHTING);
 		glEnableClientState(GL_NORMAL_ARRAY);
-		assert(normals != nullptr);
-		glNormalPointer(GL_FLOAT, 0, value_ptr(normals[0]));
+		glNormalPointer(GL_FLOAT, layout.stride, layout.normal);
 	}
 	else
 		glDisable(GL_LIGHTING);
@@ -375,6 +485,35 @@ void Mesh::setRenderStates() const
 		glPolygonMode(GL_FRONT, GL_LINE);
 }
 
+void Mesh::setTexcoordSource( const unsigned int layer
+							 , const ArrayLayout& layout ) const
+{
+	if( layout.texcoord[layer] != nullptr )
+	{
+		glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+		glTexCoordPointer(2, GL_FLOAT, layout.stride, layout.texcoord[layer]);
+		return;
+	}
+
+	// Only client arrays leave a generated layer without coordinates.
+	// Map object x,z back to grid column and row from the first 
+	// vertex and the spacing, then apply the layer's scale and offset.
+	assert(layer < texgens.size() && spread > 0.f);
+	const TexcoordGen& gen(texgens[layer]);
+	const vec3& origin(vertices[0]);
+	const GLfloat planeS[] = { gen.scale.x / spread, 0.f, 0.f
+							 , gen.offset.x - gen.scale.x * origin.x / spread };
+	const GLfloat planeT[] = { 0.f, 0.f, gen.scale.y / spread
+							 , gen.offset.y - gen.scale.y * origin.z / spread };
+
+	glTexGeni(GL_S, GL_TEXTURE_GEN_MODE, GL_OBJECT_LINEAR);
+	glTexGeni(GL_T, GL_TEXTURE_GEN_MODE, GL_OBJECT_LINEAR);
+	glTexGenfv(GL_S, GL_OBJECT_PLANE, planeS);
+	glTexGenfv(GL_T, GL_OBJECT_PLANE, planeT);
+	glEnable(GL_TEXTURE_GEN_S);
+	glEnable(GL_TEXTURE_GEN_T);
+}
+
 void Mesh::resetRenderStates() const
 {
 	// Reset polygon filling state -----------------
@@ -413,6 +552,8 @@ void Mesh::resetRenderStates() const
 			glBindTexture(GL_TEXTURE_2D, 0);
 			glTexCoordPointer(2, GL_FLOAT, 0, nullptr); 
 			glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+			glDisable(GL_TEXTURE_GEN_S);
+			glDisable(GL_TEXTURE_GEN_T);
 
 			//Switch off the TU 1
 			if( multiTexture )
@@ -422,6 +563,8 @@ void Mesh::resetRenderStates() const
 
 				glDisable(GL_TEXTURE_2D);
 				glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+				glDisable(GL_TEXTURE_GEN_S);
+				glDisable(GL_TEXTURE_GEN_T);
 
 				glActiveTexture(GL_TEXTURE0);
 				glClientActiveTexture(GL_TEXTURE0);
@@ -506,30 +649,44 @@ vec2& Mesh::texcoordAt( const unsigned int col
 	}
 }
 
-void Mesh::smoothHeights()
+void Mesh::smoothHeights( const unsigned int iterations )
 {
 	assert(vertices != nullptr);
-	for(unsigned int z = 1; z < (height - 1); ++z)
-	for(unsigned int x = 1; x < (width - 1);  ++x)
-	{
-		vec3& v0 = vertexAt(x,z);
 
-		const vec3& v1 = vertexAt(x-1, z-1);
-		const vec3& v2 = vertexAt(x-1, z+1);
-		const vec3& v3 = vertexAt(x+1, z-1);
-		const vec3& v4 = vertexAt(x+1, z+1);
+	HeightGrid grid(width, height);
+	grid.readHeights(vertices);
+	grid.smooth(iterations);
+	grid.writeHeights(vertices);
+	markDirty();
+	notifyChanged(0, 0, width - 1, height - 1);
+}
 
-		const vec3& v5 = vertexAt(x+0, z-1);
-		const vec3& v6 = vertexAt(x+0, z+1);
-		const vec3& v7 = vertexAt(x-1, z+0);
-		const vec3& v8 = vertexAt(x+1, z+0);
+unsigned int Mesh::addChangeListener( const ChangeFunc& func )
+{
+	const unsigned int id = nextListenerId++;
+	listeners.push_back(std::make_pair(id, func));
+	return id;
+}
 
-		v0.y += v1.y + v2.y + v3.y + v4.y 
-			  + v5.y + v6.y + v7.y + v8.y;
-		v0.y /= 9.f;
+void Mesh::removeChangeListener( const unsigned int id )
+{
+	for(unsigned int i = 0; i < listeners.size(); ++i)
+	{
+		if( listeners[i].first == id )
+		{
+			listeners.erase(listeners.begin() + i);
+			return;
+		}
 	}
 }
 
+void Mesh::notifyChanged( const unsigned int minx, const unsigned int minz
+						, const unsigned int maxx, const unsigned int maxz ) const
+{
+	for each(const auto& listener in listeners)
+		listener.second(minx, minz, maxx, maxz);
+}
+
 void Mesh::addTexture( const sf::Image *texture , glm::vec2 *texcoord )
 {
 	if( texture == nullptr || texcoord == nullptr )
@@ -538,8 +695,28 @@ void Mesh::addTexture( const sf::Image *texture , glm::vec2 *texcoord )
 		return;
 	}
 
+	const TexcoordGen none = { vec2(0.f), vec2(0.f) };
 	texcoords.push_back(texcoord);
+	texgens.push_back(none);
 	textures.push_back(texture);		
+	markDirty();
+}
+
+void Mesh::addTexture( const sf::Image *texture
+					 , const vec2& scale
+					 , const vec2& offset /* = vec2(0.f) */ )
+{
+	if( texture == nullptr )
+	{
+		Log("Warning: tried to add texture to mesh with null pointers");
+		return;
+	}
+
+	const TexcoordGen gen = { scale, offset };
+	texcoords.push_back(nullptr);
+	texgens.push_back(gen);
+	textures.push_back(texture);
+	markDirty();
 }
 
 void Mesh::renderNormals() const
@@ -581,28 +758,65 @@ void Mesh::renderNormals() const
 
 void Mesh::regenerateNormals()
 {
-	for(unsigned int i = 0; i < numIndices; i += 3)
+	regenerateNormals(0, 0, width - 1, height - 1);
+}
+
+void Mesh::regenerateNormals( const unsigned int minx, const unsigned int minz
+							, const unsigned int maxx, const unsigned int maxz )
+{
+	assert(vertices != nullptr);
+	assert(normals  != nullptr);
+	if( width < 2 || height < 2 || minx >= width || minz >= height )
+		return;
+
+	// Grow by the border, vertices there difference against the edit
+	const unsigned int x0 = (minx > 0) ? minx - 1 : 0;
+	const unsigned int z0 = (minz > 0) ? minz - 1 : 0;
+	const unsigned int x1 = std::min(maxx + 1, width  - 1);
+	const unsigned int z1 = std::min(maxz + 1, height - 1);
+	if( x0 > x1 || z0 > z1 )
+		return;
+
+	const unsigned int w = width;
+	const unsigned int h = height;
+	const vec3 *verts = vertices;
+	vec3 *norms = normals;
+
+	// The normal of the plane through the neighbors on either side,
+	// one-sided at the grid's edges. Matches the facing of the 
+	// triangles from GridIndices::anti_diagonal.
+	auto rows = [=](const unsigned int begin, const unsigned int end)
 	{
-		const vec3 v[3] = {
-			vertices[ indices[i+0] ],
-			vertices[ indices[i+1] ],
-			vertices[ indices[i+2] ]
-		};
-		const vec3 va = v[1] - v[0];
-		const vec3 vb = v[2] - v[0];
-		const vec3 normal = normalize( cross(va, vb) );
-
-		for(unsigned int j = 0; j < 3; ++j)
+		for(unsigned int z = begin; z < end; ++z)
 		{
-			const vec3 a = v[(j+1) % 3] - v[j];
-			const vec3 b = v[(j+2) % 3] - v[j];
-			const float weight = acos( dot(a, b) / (a.length() * b.length()) );
-			normals[ indices[i + j] ] += weight * normal;
+			const vec3 *row  = verts + z * w;
+			const vec3 *prev = verts + (z > 0     ? z - 1 : z) * w;
+			const vec3 *next = verts + (z + 1 < h ? z + 1 : z) * w;
+			vec3 *out = norms + z * w;
+
+			// Edge columns first, so the loop between them has no branches
+			unsigned int first = x0;
+			unsigned int last  = x1;
+			if( first == 0 )
+			{
+				out[0] = normalize(cross(next[0] - prev[0], row[1] - row[0]));
+				++first;
+			}
+			if( last == w - 1 && last >= first )
+			{
+				out[last] = normalize(cross(next[last] - prev[last], row[last] - row[last - 1]));
+				--last;
+			}
+
+			for(unsigned int x = first; x <= last; ++x)
+				out[x] = normalize(cross(next[x] - prev[x], row[x + 1] - row[x - 1]));
 		}
-	}
+	};
 
-	for(unsigned int i = 0; i < numVertices; ++i)
-	{
-		normals[i] = normalize(normals[i]);
-	}
+	// Keep each worker's share of rows worth the thread launch
+	const unsigned int grain = std::max(1u, 16384u / (x1 - x0 + 1));
+	parallel::forRange(z0, z1 + 1, rows, grain);
+
+	// Edits come through here too, so this covers their vertices
+	markDirty(z0, z1);
 }
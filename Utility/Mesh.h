@@ -4,27 +4,59 @@
 /* ----
 /* A simple 3d triangle mesh 
 /************************************************************************/
+#include "GridIndices.h"
+
 #include <glm/glm.hpp>
 
 #include <SFML/Graphics.hpp>
 
+#include <cassert>
+#include <functional>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace sf { class Image; }
 
 
+// One vertex as laid out in a mesh's buffer object
+struct MeshVertex
+{
+	glm::vec3 position;
+	glm::vec3 normal;
+	glm::vec4 color;
+	glm::vec2 texcoord[2];  // the two texture layers render() can use
+};
+
+
 class Mesh
 {
+public:
+	// Called with an inclusive rectangle of grid vertices whose
+	// positions changed, as minx, minz, maxx, maxz
+	typedef std::function<void (unsigned int, unsigned int, unsigned int, unsigned int)> ChangeFunc;
+
 protected:
+	// Texture coordinates computed from grid column and row, 
+	// as (col, row) * scale + offset
+	struct TexcoordGen
+	{
+		glm::vec2 scale;
+		glm::vec2 offset;
+	};
+
 	glm::vec4 *colors;
 	glm::vec3 *vertices;
 	glm::vec3 *normals;
 
+	// One entry of each per texture layer, a layer either owns an 
+	// array of coordinates or has a null array and is generated
 	std::vector<glm::vec2*>       texcoords;
+	std::vector<TexcoordGen>      texgens;
 	std::vector<const sf::Image*> textures;
 
-	unsigned int *indices;
+	// Shared with every other mesh of the same dimensions
+	const GridIndices *indices;
 
 	unsigned int mode;
 	unsigned int width;
@@ -42,7 +74,15 @@ protected:
 	bool texture;
 	bool multiTexture;
 
-	// TODO: vertex buffer object management
+	// Buffer object of interleaved vertices, created on first render
+	mutable unsigned int vbo;
+	// Vertices [dirtyBegin, dirtyEnd) changed since the last upload
+	mutable unsigned int dirtyBegin;
+	mutable unsigned int dirtyEnd;
+
+	// Functions told about vertex changes, by the id they were given
+	std::vector<std::pair<unsigned int, ChangeFunc> > listeners;
+	unsigned int nextListenerId;
 
 public:
 	// Create an uninitialized mesh
@@ -69,9 +109,32 @@ public:
 	// Render this mesh to the screen in the positive quadrant of the XZ-plane
 	virtual void render() const;
 
-	// Add a new texture layer to this mesh
+	// Add a new texture layer to this mesh, taking ownership of an
+	// array of numVertices texture coordinates
 	void addTexture(const sf::Image *texture
 				  , glm::vec2 *texcoord);
+	// Add a texture layer whose coordinates are an affine function of
+	// the grid, so nothing is stored per vertex. They are computed 
+	// when vertices are packed, or by texgen without buffer objects.
+	void addTexture(const sf::Image *texture
+				  , const glm::vec2& scale
+				  , const glm::vec2& offset = glm::vec2(0.f));
+
+	// Copy vertices [first, first + count) into the interleaved layout,
+	// generated layers are computed and missing layers packed as zero
+	void packVertices( const unsigned int first
+					 , const unsigned int count
+					 , MeshVertex *out ) const;
+
+	// Flag vertices for upload on the next render, needed after 
+	// writing through the *At or *Row accessors
+	void markDirty();
+	void markDirty(const unsigned int minRow, const unsigned int maxRow);
+
+	// Register a function to hear about changed vertices, such as a
+	// mesh draped over this one, returning an id to remove it with
+	unsigned int addChangeListener(const ChangeFunc& func);
+	void removeChangeListener(const unsigned int id);
 
 	// Render state toggles
 	void toggleBlending();
@@ -95,11 +158,25 @@ public:
 	glm::vec3& vertexAt  (const unsigned int col, const unsigned int row);
 	// Returns a reference to the normal value at the specified grid indices
 	glm::vec3& normalAt  (const unsigned int col, const unsigned int row);
-	// Returns a reference to the texture coord value at specified grid indices
+	// Returns a reference to the texture coord value at specified grid 
+	// indices, only for layers added with an array of coordinates
 	glm::vec2& texcoordAt(const unsigned int col
                         , const unsigned int row
                         , const unsigned int layer);
 
+	// Unchecked row access for inner loops, only asserted in debug 
+	// builds. Each row is getWidth() contiguous values, and row r+1 
+	// directly follows row r, so the whole grid is row 0 with 
+	// getNumVertices() values.
+	glm::vec4*       colorRow   (const unsigned int row);
+	const glm::vec4* colorRow   (const unsigned int row) const;
+	glm::vec3*       vertexRow  (const unsigned int row);
+	const glm::vec3* vertexRow  (const unsigned int row) const;
+	glm::vec3*       normalRow  (const unsigned int row);
+	const glm::vec3* normalRow  (const unsigned int row) const;
+	glm::vec2*       texcoordRow(const unsigned int row, const unsigned int layer);
+	const glm::vec2* texcoordRow(const unsigned int row, const unsigned int layer) const;
+
 private:
 	// Non-copyable
 	Mesh(const Mesh& other);
@@ -111,16 +188,12 @@ private:
 				  , const unsigned int height
 				  , const float spread
 				  , const unsigned int elementMode);
-	void initialize(const std::string& imageFileName
-				  , const float spread
-				  , const float heightSpread
-				  , const unsigned int elementMode);
 	void initialize(const sf::Image& image
 				  , const float spread
 				  , const float heightSpread
 				  , const unsigned int elementMode);
 
-	// Generate indices for a planar mesh
+	// Look up the shared indices for a planar mesh
 	void generateArrayIndices();
 	// Generate vertices in the XZ-plane
 	void regenerateArrays( const unsigned int w
@@ -133,8 +206,29 @@ private:
 	// Set all member data to some known zero value
 	void zeroMembers();
 
+	// Where render() finds each vertex attribute, either client
+	// memory or offsets into the bound buffer object
+	struct ArrayLayout
+	{
+		const void *position;
+		const void *normal;
+		const void *color;
+		const void *texcoord[2];
+		int stride;
+	};
+
+	// Bind the buffer object, uploading any dirty vertices first, or
+	// fall back to the client arrays where buffers are unsupported,
+	// leaving generated layers null
+	ArrayLayout bindArrays() const;
+
+	// Point the active texture unit at a layer's coordinates, or 
+	// set up object linear texgen for a generated layer that has none
+	void setTexcoordSource( const unsigned int layer
+						  , const ArrayLayout& layout ) const;
+
 	// Enable or disable OpenGL states based on state flags
-	void setRenderStates()   const;
+	void setRenderStates(const ArrayLayout& layout) const;
 	// Undo OpenGL state changes made in setRenderStates()
 	void resetRenderStates() const;
 
@@ -142,10 +236,33 @@ private:
 	void renderNormals() const;
 
 protected:
-	// Apply a box filter over the y-values of each vertex
-	void smoothHeights();
-	// Regenerate vertex normals
+	// Build the mesh from an image, for subclasses that construct 
+	// an empty mesh before choosing where their vertices come from
+	void initialize(const std::string& imageFileName
+				  , const float spread
+				  , const float heightSpread
+				  , const unsigned int elementMode);
+
+	// Size the mesh and allocate its arrays, leaving their contents
+	// for the caller to fill
+	void allocateArrays(const unsigned int w, const unsigned int h);
+
+	// Issue the draw call once vertex arrays and render states are set
+	virtual void drawElements() const;
+
+	// Tell the listeners an inclusive rectangle of vertices changed
+	void notifyChanged( const unsigned int minx, const unsigned int minz
+					  , const unsigned int maxx, const unsigned int maxz ) const;
+
+	// Apply a number of 3x3 box filter passes over the y-values 
+	// of each vertex, see HeightGrid::smooth()
+	void smoothHeights(const unsigned int iterations = 1);
+	// Regenerate vertex normals from central differences over the grid
 	void regenerateNormals();
+	// Regenerate normals for an inclusive rectangle of grid vertices,
+	// along with the one vertex border whose differences it touches
+	void regenerateNormals( const unsigned int minx, const unsigned int minz
+						  , const unsigned int maxx, const unsigned int maxz );
 };
 
 
@@ -162,3 +279,51 @@ inline unsigned int Mesh::getHeight()       const { return height; }
 inline unsigned int Mesh::getNumIndices()   const { return numIndices; }
 inline unsigned int Mesh::getNumVertices()  const { return numVertices; }
 inline unsigned int Mesh::getNumTriangles() const { return numTriangles; }
+
+inline glm::vec4* Mesh::colorRow(const unsigned int row)
+{
+	assert(colors != nullptr && row < height);
+	return colors + row * width;
+}
+
+inline const glm::vec4* Mesh::colorRow(const unsigned int row) const
+{
+	assert(colors != nullptr && row < height);
+	return colors + row * width;
+}
+
+inline glm::vec3* Mesh::vertexRow(const unsigned int row)
+{
+	assert(vertices != nullptr && row < height);
+	return vertices + row * width;
+}
+
+inline const glm::vec3* Mesh::vertexRow(const unsigned int row) const
+{
+	assert(vertices != nullptr && row < height);
+	return vertices + row * width;
+}
+
+inline glm::vec3* Mesh::normalRow(const unsigned int row)
+{
+	assert(normals != nullptr && row < height);
+	return normals + row * width;
+}
+
+inline const glm::vec3* Mesh::normalRow(const unsigned int row) const
+{
+	assert(normals != nullptr && row < height);
+	return normals + row * width;
+}
+
+inline glm::vec2* Mesh::texcoordRow(const unsigned int row, const unsigned int layer)
+{
+	assert(layer < texcoords.size() && texcoords[layer] != nullptr && row < height);
+	return texcoords[layer] + row * width;
+}
+
+inline const glm::vec2* Mesh::texcoordRow(const unsigned int row, const unsigned int layer) const
+{
+	assert(layer < texcoords.size() && texcoords[layer] != nullptr && row < height);
+	return texcoords[layer] + row * width;
+}
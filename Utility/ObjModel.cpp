@@ -6,11 +6,13 @@
 /************************************************************************/
 #include "ObjModel.h"
 #include "Logger.h"
+#include "VertexCache.h"
 
 #include "../Lib/glm-obj/glm.h"
 
 #include <sstream>
 #include <string>
+#include <vector>
 
 
 ObjModel::ObjModel( const std::string& filename
@@ -36,6 +38,8 @@ ObjModel::ObjModel( const std::string& filename
 		// Calculate normals
 		glmFacetNormals(model);
 		glmVertexNormals(model, 90.f);
+
+		optimizeOrder();
 	}
 }
 
@@ -44,3 +48,63 @@ ObjModel::~ObjModel()
 	if( model != nullptr )
 		glmDelete(model);
 }
+
+void ObjModel::optimizeOrder()
+{
+	// Triangles are ordered by their position indices, normals and 
+	// texture coordinates have indices of their own and stay put
+	const unsigned int numVertices = model->numvertices + 1;
+	std::vector<unsigned int> before, after, groupIndices, order, triangles;
+
+	for(GLMgroup *group = model->groups; group != nullptr; group = group->next)
+	{
+		if( group->numtriangles == 0 )
+			continue;
+
+		groupIndices.clear();
+		for(unsigned int i = 0; i < group->numtriangles; ++i)
+		{
+			const GLMtriangle& triangle = model->triangles[group->triangles[i]];
+			groupIndices.insert(groupIndices.end(), triangle.vindices, triangle.vindices + 3);
+		}
+		before.insert(before.end(), groupIndices.begin(), groupIndices.end());
+
+		// Groups are drawn one after another, each with its own 
+		// material, so each is ordered on its own
+		vertexcache::optimizeTriangleOrder(&groupIndices[0], groupIndices.size(), numVertices, order);
+
+		triangles.assign(group->triangles, group->triangles + group->numtriangles);
+		for(unsigned int i = 0; i < order.size(); ++i)
+		{
+			group->triangles[i] = triangles[order[i]];
+			const GLMtriangle& triangle = model->triangles[group->triangles[i]];
+			after.insert(after.end(), triangle.vindices, triangle.vindices + 3);
+		}
+	}
+
+	if( after.empty() )
+		return;
+	const vertexcache::Stats oldStats = vertexcache::measure(&before[0], before.size());
+	const vertexcache::Stats newStats = vertexcache::measure(&after[0],  after.size());
+
+	// GLM counts vertices from 1, leading with index 0 keeps it first
+	std::vector<unsigned int> drawOrder(1, 0);
+	drawOrder.insert(drawOrder.end(), after.begin(), after.end());
+	std::vector<unsigned int> remap;
+	vertexcache::optimizeVertexOrder(&drawOrder[0], drawOrder.size(), numVertices, remap);
+
+	const std::vector<GLfloat> positions(model->vertices, model->vertices + 3 * numVertices);
+	for(unsigned int v = 0; v < numVertices; ++v)
+	for(unsigned int k = 0; k < 3; ++k)
+		model->vertices[3 * remap[v] + k] = positions[3 * v + k];
+
+	for(unsigned int t = 0; t < model->numtriangles; ++t)
+	for(unsigned int k = 0; k < 3; ++k)
+		model->triangles[t].vindices[k] = remap[model->triangles[t].vindices[k]];
+
+	std::stringstream ss;
+	ss << "Reordered \"" << filename << "\" for the vertex cache, ACMR " 
+	   << oldStats.acmr << " -> " << newStats.acmr << ", ATVR " 
+	   << oldStats.atvr << " -> " << newStats.atvr;
+	Log(ss);
+}
@@ -24,6 +24,11 @@ public:
 
 	void render();
 	void setRenderMode(unsigned int renderMode);
+
+private:
+	// Put each group's triangles in vertex cache order and number
+	// the vertices in the order those triangles first use them
+	void optimizeOrder();
 };
 
 
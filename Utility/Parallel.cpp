@@ -0,0 +1,245 @@
+/************************************************************************/
+/* Parallel
+/* --------
+/* Simple fork-join helpers on a pool of sf::Threads
+/************************************************************************/
+#include "Parallel.h"
+
+#include <SFML/System/Lock.hpp>
+#include <SFML/System/Mutex.hpp>
+#include <SFML/System/Thread.hpp>
+
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h>
+#else
+	#include <semaphore.h>
+	#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <vector>
+
+
+namespace
+{
+	// Work item handed to each worker
+	struct RangeJob
+	{
+		const parallel::RangeFunc *body;
+		unsigned int begin;
+		unsigned int end;
+	};
+
+	// Counting semaphore, so an idle worker sleeps until it's given
+	// work instead of polling for it
+	class Semaphore
+	{
+	private:
+#ifdef _WIN32
+		HANDLE handle;
+#else
+		sem_t sem;
+#endif
+
+	public:
+#ifdef _WIN32
+		Semaphore()  { handle = CreateSemaphore(nullptr, 0, LONG_MAX, nullptr); }
+		~Semaphore() { CloseHandle(handle); }
+		void post()  { ReleaseSemaphore(handle, 1, nullptr); }
+		void wait()  { WaitForSingleObject(handle, INFINITE); }
+#else
+		Semaphore()  { sem_init(&sem, 0, 0); }
+		~Semaphore() { sem_destroy(&sem); }
+		void post()  { sem_post(&sem); }
+		void wait()  { while( sem_wait(&sem) != 0 ) { } }
+#endif
+
+	private:
+		// No copying
+		Semaphore(const Semaphore&);
+		Semaphore& operator=(const Semaphore&);
+	};
+
+	// Threads started once and kept waiting for ranges, so a 
+	// forRange() costs a wake-up per worker rather than a launch
+	class WorkerPool
+	{
+	private:
+		struct Worker
+		{
+			WorkerPool *pool;
+			sf::Thread *thread;
+			Semaphore wake;
+			RangeJob job;
+		};
+
+		std::vector<Worker*> workers;
+		Semaphore done;       // posted once per finished job
+		sf::Mutex mutex;
+		bool busy;            // a forRange() has the workers
+		bool stopping;
+
+	public:
+		WorkerPool(const unsigned int count)
+			: workers()
+			, done()
+			, mutex()
+			, busy(false)
+			, stopping(false)
+		{
+			for(unsigned int i = 0; i < count; ++i)
+			{
+				Worker *worker = new Worker();
+				worker->pool   = this;
+				worker->thread = new sf::Thread(&WorkerPool::runWorker, worker);
+				workers.push_back(worker);
+				worker->thread->Launch();
+			}
+		}
+
+		~WorkerPool()
+		{
+			stopping = true;
+			for each(auto worker in workers)
+				worker->wake.post();
+			for each(auto worker in workers)
+			{
+				worker->thread->Wait();
+				delete worker->thread;
+				delete worker;
+			}
+		}
+
+		unsigned int size() const { return workers.size(); }
+
+		// Claim the workers, false if another forRange() has them, 
+		// as when called from inside a job or from another thread
+		bool acquire()
+		{
+			sf::Lock lock(mutex);
+			if( busy )
+				return false;
+			busy = true;
+			return true;
+		}
+
+		void release()
+		{
+			sf::Lock lock(mutex);
+			busy = false;
+		}
+
+		// Hand all but the last job to the workers, run the last on 
+		// this thread and wait for the rest
+		void run(const std::vector<RangeJob>& jobs)
+		{
+			assert(!jobs.empty() && jobs.size() <= workers.size() + 1);
+			const unsigned int forked = jobs.size() - 1;
+			for(unsigned int i = 0; i < forked; ++i)
+			{
+				workers[i]->job = jobs[i];
+				workers[i]->wake.post();
+			}
+
+			const RangeJob& last = jobs.back();
+			(*last.body)(last.begin, last.end);
+
+			for(unsigned int i = 0; i < forked; ++i)
+				done.wait();
+		}
+
+	private:
+		static void runWorker(void *userData)
+		{
+			Worker *worker = static_cast<Worker*>(userData);
+			WorkerPool *pool = worker->pool;
+			for(;;)
+			{
+				worker->wake.wait();
+				if( pool->stopping )
+					return;
+
+				(*worker->job.body)(worker->job.begin, worker->job.end);
+				pool->done.post();
+			}
+		}
+
+		// No copying
+		WorkerPool(const WorkerPool&);
+		WorkerPool& operator=(const WorkerPool&);
+	};
+
+	// Created on the first forRange(), the calling thread is 
+	// always one of the workers
+	WorkerPool& workerPool()
+	{
+		static WorkerPool pool(parallel::numWorkers() - 1);
+		return pool;
+	}
+}
+
+
+unsigned int parallel::numWorkers()
+{
+	static unsigned int count = 0;
+	if( count == 0 )
+	{
+#ifdef _WIN32
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		count = static_cast<unsigned int>(info.dwNumberOfProcessors);
+#else
+		const long n = sysconf(_SC_NPROCESSORS_ONLN);
+		count = (n > 0) ? static_cast<unsigned int>(n) : 1;
+#endif
+		if( count == 0 )
+			count = 1;
+	}
+	return count;
+}
+
+void parallel::forRange( const unsigned int begin
+					   , const unsigned int end
+					   , const RangeFunc& body
+					   , const unsigned int grain /* = 1 */ )
+{
+	if( end <= begin )
+		return;
+
+	const unsigned int total    = end - begin;
+	const unsigned int maxSplit = std::max(1u, total / std::max(1u, grain));
+	const unsigned int numJobs  = std::min(numWorkers(), maxSplit);
+
+	if( numJobs <= 1 )
+	{
+		body(begin, end);
+		return;
+	}
+
+	WorkerPool& pool = workerPool();
+	if( !pool.acquire() )
+	{
+		body(begin, end);
+		return;
+	}
+
+	// Divide the range as evenly as possible
+	std::vector<RangeJob> jobs(numJobs);
+	const unsigned int chunk = total / numJobs;
+	const unsigned int extra = total % numJobs;
+	unsigned int first = begin;
+	for(unsigned int i = 0; i < numJobs; ++i)
+	{
+		const unsigned int count = chunk + (i < extra ? 1 : 0);
+		jobs[i].body  = &body;
+		jobs[i].begin = first;
+		jobs[i].end   = first + count;
+		first += count;
+	}
+
+	pool.run(jobs);
+	pool.release();
+}
@@ -0,0 +1,28 @@
+#pragma once
+/************************************************************************/
+/* Parallel
+/* --------
+/* Simple fork-join helpers on a pool of sf::Threads
+/************************************************************************/
+#include <functional>
+
+
+namespace parallel
+{
+	// Called with a [begin,end) sub-range of the work
+	typedef std::function<void (unsigned int, unsigned int)> RangeFunc;
+
+	// Number of hardware threads available to the process
+	unsigned int numWorkers();
+
+	// Split [begin,end) into at most numWorkers() contiguous ranges 
+	// and run body on each range concurrently, the calling thread 
+	// takes the last range and the call returns once all are done.
+	// Ranges are never smaller than grain, so small jobs run serially.
+	// The other ranges go to worker threads started by the first call,
+	// while they're taken, as by a nested call, the body runs serially.
+	void forRange( const unsigned int begin
+				 , const unsigned int end
+				 , const RangeFunc& body
+				 , const unsigned int grain = 1 );
+};
@@ -0,0 +1,139 @@
+/************************************************************************/
+/* PoissonScatter
+/* --------------
+/* Blue noise points over an area of the ground plane, no two closer
+/* than a radius, thinned by a density mask and kept clear of boxes
+/************************************************************************/
+#include "PoissonScatter.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+using namespace glm;
+
+
+PoissonScatter::PoissonScatter( const vec2& minXZ
+							  , const vec2& maxXZ
+							  , const unsigned int seed )
+	: minXZ(minXZ)
+	, maxXZ(max(minXZ, maxXZ))
+	, state(seed != 0 ? seed : 0x9e3779b9)
+	, grid()
+	, active()
+	, samples()
+{ }
+
+unsigned int PoissonScatter::scatter( const float radius
+									, std::vector<vec2>& points
+									, const DensityFunc& density
+									, const BoundsGrid *exclusions
+									, const float clearance )
+{
+	assert(radius > 0.f);
+	const vec2 size(maxXZ - minXZ);
+
+	// Cells small enough to hold at most one sample each, so only
+	// the two cells around a candidate's cell can hold a neighbor
+	const float cellSize = radius / sqrt(2.f);
+	const unsigned int cellsX = std::max(1u, static_cast<unsigned int>(ceil(size.x / cellSize)));
+	const unsigned int cellsZ = std::max(1u, static_cast<unsigned int>(ceil(size.y / cellSize)));
+	grid.assign(cellsX * cellsZ, -1);
+	active.clear();
+	samples.clear();
+
+	const float radiusSq = radius * radius;
+	auto cellOf = [&](const vec2& p, unsigned int& cx, unsigned int& cz)
+	{
+		cx = std::min(static_cast<unsigned int>((p.x - minXZ.x) / cellSize), cellsX - 1);
+		cz = std::min(static_cast<unsigned int>((p.y - minXZ.y) / cellSize), cellsZ - 1);
+	};
+	auto add = [&](const vec2& p)
+	{
+		unsigned int cx, cz;
+		cellOf(p, cx, cz);
+		grid[cz * cellsX + cx] = samples.size();
+		active.push_back(samples.size());
+		samples.push_back(p);
+	};
+
+	add(minXZ + vec2(random(), random()) * size);
+	while( !active.empty() )
+	{
+		const unsigned int numActive = active.size();
+		const unsigned int slot = std::min(static_cast<unsigned int>(random() * numActive), numActive - 1);
+		const vec2 center(samples[active[slot]]);
+
+		// Try candidates in the ring between radius and twice it
+		bool spawned = false;
+		for(unsigned int t = 0; t < maxTries && !spawned; ++t)
+		{
+			const float angle    = 6.2831853f * random();
+			const float distance = radius * (1.f + random());
+			const vec2 p(center + distance * vec2(cos(angle), sin(angle)));
+			if( p.x < minXZ.x || p.y < minXZ.y || p.x >= maxXZ.x || p.y >= maxXZ.y )
+				continue;
+
+			unsigned int cx, cz;
+			cellOf(p, cx, cz);
+			const unsigned int x0 = (cx >= 2) ? cx - 2 : 0, x1 = std::min(cx + 2, cellsX - 1);
+			const unsigned int z0 = (cz >= 2) ? cz - 2 : 0, z1 = std::min(cz + 2, cellsZ - 1);
+
+			bool clear = true;
+			for(unsigned int z = z0; z <= z1 && clear; ++z)
+			for(unsigned int x = x0; x <= x1 && clear; ++x)
+			{
+				const int other = grid[z * cellsX + x];
+				if( other >= 0 )
+				{
+					const vec2 d(samples[other] - p);
+					clear = (dot(d, d) >= radiusSq);
+				}
+			}
+
+			if( clear )
+			{
+				add(p);
+				spawned = true;
+			}
+		}
+
+		if( !spawned )
+		{
+			active[slot] = active.back();
+			active.pop_back();
+		}
+	}
+
+	// Thin by the mask and exclusions, then shuffle what's kept
+	const unsigned int first = points.size();
+	const float tall = std::numeric_limits<float>::max();
+	for each(auto p in samples)
+	{
+		if( density && random() >= density(p) )
+			continue;
+		if( exclusions != nullptr
+		 && exclusions->overlaps(vec3(p.x - clearance, -tall, p.y - clearance)
+							   , vec3(p.x + clearance,  tall, p.y + clearance)) )
+			continue;
+		points.push_back(p);
+	}
+
+	for(unsigned int i = points.size(); i > first + 1; --i)
+	{
+		const unsigned int j = first + std::min(static_cast<unsigned int>(random() * (i - first)), i - first - 1);
+		std::swap(points[i - 1], points[j]);
+	}
+	return points.size() - first;
+}
+
+float PoissonScatter::random()
+{
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return (state >> 8) * (1.f / 16777216.f);
+}
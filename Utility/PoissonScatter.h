@@ -0,0 +1,68 @@
+#pragma once
+/************************************************************************/
+/* PoissonScatter
+/* --------------
+/* Blue noise points over an area of the ground plane, no two closer
+/* than a radius, thinned by a density mask and kept clear of boxes
+/************************************************************************/
+#include "BoundsGrid.h"
+
+#include <glm/glm.hpp>
+
+#include <functional>
+#include <vector>
+
+
+class PoissonScatter
+{
+public:
+	// Chance in [0,1] of keeping a point
+	typedef std::function<float (const glm::vec2&)> DensityFunc;
+
+	// Candidates tried around a point before it stops spawning more
+	static const unsigned int maxTries = 30;
+
+private:
+	glm::vec2 minXZ;
+	glm::vec2 maxXZ;
+	unsigned int state;   // xorshift random state
+
+	// Working storage of a scatter, kept to be reused
+	std::vector<int> grid;              // sample in each cell, or -1
+	std::vector<unsigned int> active;   // samples still spawning others
+	std::vector<glm::vec2> samples;
+
+public:
+	// Scatter over an area of the xz plane, the same seed
+	// gives the same points
+	PoissonScatter( const glm::vec2& minXZ
+				  , const glm::vec2& maxXZ
+				  , const unsigned int seed = 1 );
+
+	/**
+	 * Fill the area with points no closer than radius to each other by
+	 * Bridson's algorithm, in time linear in the number of points, then
+	 * keep each with the chance density gives and drop those within
+	 * clearance of a box in exclusions (on x and z only)
+	 * \param radius  - the least distance between points
+	 * \param points  - the points kept are appended in random order,
+	 *                  so any prefix is still spread over the area
+	 * \param density - if set, the chance of keeping a point
+	 * \param exclusions - if not null, boxes to keep points out of
+	 * \param clearance  - how far points stay from the exclusions
+	 * \return - the number of points appended
+	**/
+	unsigned int scatter( const float radius
+						, std::vector<glm::vec2>& points
+						, const DensityFunc& density = DensityFunc()
+						, const BoundsGrid *exclusions = nullptr
+						, const float clearance = 0.f );
+
+private:
+	// Uniform in [0,1)
+	float random();
+
+	// No copying
+	PoissonScatter(const PoissonScatter&);
+	PoissonScatter& operator=(const PoissonScatter&);
+};
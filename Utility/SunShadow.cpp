@@ -0,0 +1,126 @@
+/************************************************************************/
+/* SunShadow
+/* ---------
+/* A soft shadow mask over a HeightGrid for a directional sun, swept
+/* a few lines at a time so a new sun direction costs a fixed amount
+/* of work per frame
+/************************************************************************/
+#include "SunShadow.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+using namespace glm;
+
+
+SunShadow::SunShadow()
+	: width(0)
+	, height(0)
+	, spacing(1.f)
+	, sun(0.f, 1.f, 0.f)
+	, acrossX(true)
+	, towardSun(1)
+	, slope(0.f)
+	, drop(0.f)
+	, numLines(0)
+	, lineLength(0)
+	, nextLine(0)
+	, previous()
+	, current()
+	, light()
+	, pending()
+{ }
+
+bool SunShadow::begin( const HeightGrid& grid, const float spacing, const vec3& sunDirection )
+{
+	width  = grid.getWidth();
+	height = grid.getHeight();
+	this->spacing = spacing;
+	sun = sunDirection;
+
+	const unsigned int numVertices = width * height;
+	pending.resize(numVertices);
+	numLines = nextLine = 0;
+
+	// Below the horizon nothing is lit, overhead nothing is shadowed
+	const vec2 flat(sun.x, sun.z);
+	const float flatLength = length(flat);
+	if( sun.y <= 0.f || flatLength < 1e-4f )
+	{
+		std::fill(pending.begin(), pending.end(), (sun.y <= 0.f) ? 0 : 255);
+		finish();
+		return true;
+	}
+
+	acrossX    = (abs(flat.x) >= abs(flat.y));
+	const float major = acrossX ? flat.x : flat.y;
+	const float minor = acrossX ? flat.y : flat.x;
+	towardSun  = (major > 0.f) ? 1 : -1;
+	slope      = minor / abs(major);
+	drop       = spacing * sqrt(1.f + slope * slope) * sun.y / flatLength;
+	numLines   = acrossX ? width  : height;
+	lineLength = acrossX ? height : width;
+
+	previous.resize(lineLength);
+	current.resize(lineLength);
+	return false;
+}
+
+bool SunShadow::step( const HeightGrid& grid, const unsigned int maxLines )
+{
+	if( !isSweeping() )
+		return false;
+	assert(grid.getWidth() == width && grid.getHeight() == height);
+
+	// Penumbra over a grid step of height, so edges fade instead
+	// of stepping from vertex to vertex
+	const float penumbra = spacing;
+
+	const unsigned int last = std::min(numLines, nextLine + maxLines);
+	for(; nextLine < last; ++nextLine)
+	{
+		const unsigned int line = (towardSun > 0) ? numLines - 1 - nextLine : nextLine;
+		for(unsigned int j = 0; j < lineLength; ++j)
+		{
+			const unsigned int x = acrossX ? line : j;
+			const unsigned int z = acrossX ? j : line;
+			const float h = grid.at(x, z);
+
+			// The shadow volume over this vertex is the one over the
+			// point a line nearer the sun, lowered by how far the
+			// sun's rays fall in between, or the ground if higher
+			float top = h;
+			unsigned char lit = 255;
+			const float u = j + slope;
+			if( nextLine > 0 && u >= 0.f && u <= lineLength - 1.f && lineLength > 1 )
+			{
+				const unsigned int j0 = std::min(static_cast<unsigned int>(u), lineLength - 2);
+				const float f = u - j0;
+				const float over = previous[j0] * (1.f - f) + previous[j0 + 1] * f - drop;
+				if( over > h )
+				{
+					top = over;
+					lit = static_cast<unsigned char>(255.f * std::max(0.f, 1.f - (over - h) / penumbra) + 0.5f);
+				}
+			}
+
+			current[j] = top;
+			pending[z * width + x] = lit;
+		}
+		previous.swap(current);
+	}
+
+	if( isSweeping() )
+		return false;
+
+	finish();
+	return true;
+}
+
+void SunShadow::finish()
+{
+	light.swap(pending);
+}
@@ -0,0 +1,74 @@
+#pragma once
+/************************************************************************/
+/* SunShadow
+/* ---------
+/* A soft shadow mask over a HeightGrid for a directional sun, swept
+/* a few lines at a time so a new sun direction costs a fixed amount
+/* of work per frame
+/************************************************************************/
+#include "HeightGrid.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+
+class SunShadow
+{
+private:
+	unsigned int width;
+	unsigned int height;
+	float spacing;         // ground distance between neighboring vertices
+	glm::vec3 sun;         // direction of the pass in progress
+
+	// A pass walks lines across the axis the sun is most along,
+	// starting from the side facing the sun
+	bool  acrossX;         // lines are columns rather than rows
+	int   towardSun;       // +1 or -1 along that axis
+	float slope;           // offset along a line of the point one line nearer the sun
+	float drop;            // how far a sun ray falls between lines
+	unsigned int numLines;
+	unsigned int lineLength;
+	unsigned int nextLine; // pass index of the next line to sweep
+
+	// Height of the shadow volume over the last and current line
+	std::vector<float> previous;
+	std::vector<float> current;
+
+	// Light reaching each vertex, 0 in full shadow to 255 in full
+	// sun, for the last complete pass and the one in progress
+	std::vector<unsigned char> light;
+	std::vector<unsigned char> pending;
+
+public:
+	SunShadow();
+
+	// Start a pass toward a unit sun direction, abandoning any pass in
+	// progress, spacing is the ground distance between vertices. A sun
+	// straight overhead or below the horizon finishes right away and
+	// true is returned.
+	bool begin(const HeightGrid& grid, const float spacing, const glm::vec3& sunDirection);
+
+	// Sweep at most maxLines more lines of the pass in progress,
+	// true if that finished the pass and the light changed
+	bool step(const HeightGrid& grid, const unsigned int maxLines);
+
+	// Light reaching a vertex from the last complete pass,
+	// every vertex is lit before the first pass completes
+	float getLight(const unsigned int vertex) const;
+
+	bool isSweeping() const;
+	const glm::vec3& getSunDirection() const;
+
+private:
+	void finish();
+};
+
+
+inline float SunShadow::getLight(const unsigned int vertex) const
+{
+	return light.empty() ? 1.f : light[vertex] / 255.f;
+}
+
+inline bool SunShadow::isSweeping() const { return nextLine < numLines; }
+inline const glm::vec3& SunShadow::getSunDirection() const { return sun; }
@@ -0,0 +1,282 @@
+/************************************************************************/
+/* VertexCache
+/* -----------
+/* Orders indexed triangles to reuse the post-transform vertex cache
+/* and vertices for fetch locality, and measures an ordering against
+/* a simulated cache so the gain can be checked without a GPU
+/************************************************************************/
+#include "VertexCache.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+
+namespace
+{
+	// Scoring from Forsyth's article, the three most recent vertices
+	// score a little lower so the next triangle doesn't just reuse
+	// the last one's edge, and vertices with few triangles left score 
+	// higher so they get finished off instead of lingering
+	const float lastTriangleScore = 0.75f;
+	const float cacheDecayPower   = 1.5f;
+	const float valenceBoostScale = 2.f;
+	const float valenceBoostPower = 0.5f;
+
+	float vertexScore( const int cachePosition
+					 , const unsigned int remaining
+					 , const unsigned int cacheSize )
+	{
+		if( remaining == 0 )
+			return -1.f;
+
+		float score = 0.f;
+		if( cachePosition >= 0 )
+		{
+			if( cachePosition < 3 )
+				score = lastTriangleScore;
+			else
+			{
+				const float scale = 1.f / (cacheSize - 3);
+				score = std::pow(1.f - (cachePosition - 3) * scale, cacheDecayPower);
+			}
+		}
+
+		return score + valenceBoostScale * std::pow(static_cast<float>(remaining), -valenceBoostPower);
+	}
+}
+
+
+template<typename Index>
+vertexcache::Stats vertexcache::measure( const Index *indices
+									   , const unsigned int count
+									   , const unsigned int cacheSize )
+{
+	Stats stats = { count / 3, 0, 0, 0.f, 0.f };
+	if( count == 0 )
+		return stats;
+
+	const unsigned int numVertices = *std::max_element(indices, indices + count) + 1u;
+
+	// A vertex is cached while fewer than cacheSize misses have 
+	// happened since it was loaded
+	std::vector<unsigned int> loadedAt(numVertices, 0);
+	std::vector<bool> seen(numVertices, false);
+	for(unsigned int i = 0; i < count; ++i)
+	{
+		const unsigned int v = indices[i];
+		if( !seen[v] )
+		{
+			seen[v] = true;
+			++stats.numVertices;
+		}
+		else if( stats.transforms - loadedAt[v] < cacheSize )
+			continue;
+
+		loadedAt[v] = stats.transforms++;
+	}
+
+	stats.acmr = stats.numTriangles > 0 ? static_cast<float>(stats.transforms) / stats.numTriangles : 0.f;
+	stats.atvr = stats.numVertices  > 0 ? static_cast<float>(stats.transforms) / stats.numVertices  : 0.f;
+	return stats;
+}
+
+template<typename Index>
+void vertexcache::optimizeTriangleOrder( const Index *indices
+									   , const unsigned int count
+									   , const unsigned int numVertices
+									   , std::vector<unsigned int>& order
+									   , const unsigned int cacheSize )
+{
+	assert(count % 3 == 0 && cacheSize > 3);
+	const unsigned int numTriangles = count / 3;
+	order.clear();
+	order.reserve(numTriangles);
+	if( numTriangles == 0 )
+		return;
+
+	// Triangles using each vertex, packed by vertex
+	std::vector<unsigned int> remaining(numVertices, 0);
+	for(unsigned int i = 0; i < count; ++i)
+	{
+		assert(indices[i] < numVertices);
+		++remaining[indices[i]];
+	}
+
+	std::vector<unsigned int> firstTriangle(numVertices + 1, 0);
+	for(unsigned int v = 0; v < numVertices; ++v)
+		firstTriangle[v + 1] = firstTriangle[v] + remaining[v];
+
+	std::vector<unsigned int> vertexTriangles(count);
+	std::vector<unsigned int> filled(firstTriangle.begin(), firstTriangle.end() - 1);
+	for(unsigned int i = 0; i < count; ++i)
+		vertexTriangles[filled[indices[i]]++] = i / 3;
+
+	std::vector<int>   cachePosition(numVertices, -1);
+	std::vector<float> score(numVertices);
+	for(unsigned int v = 0; v < numVertices; ++v)
+		score[v] = vertexScore(-1, remaining[v], cacheSize);
+
+	std::vector<float> triangleScore(numTriangles);
+	std::vector<bool>  added(numTriangles, false);
+	for(unsigned int t = 0; t < numTriangles; ++t)
+		triangleScore[t] = score[indices[3*t]] + score[indices[3*t+1]] + score[indices[3*t+2]];
+
+	// The cache holds three extra entries while a triangle is added,
+	// those pushed past the end are the ones evicted
+	std::vector<unsigned int> cache, nextCache;
+	cache.reserve(cacheSize + 3);
+	nextCache.reserve(cacheSize + 3);
+
+	unsigned int scanFrom = 0;
+	int best = -1;
+	for(;;)
+	{
+		// With nothing in the cache to build on, take the best 
+		// remaining triangle, skipping the prefix already taken
+		if( best < 0 )
+		{
+			float bestScore = -1.f;
+			for(unsigned int t = scanFrom; t < numTriangles; ++t)
+			{
+				if( added[t] )
+				{
+					if( t == scanFrom )
+						++scanFrom;
+					continue;
+				}
+				if( triangleScore[t] > bestScore )
+				{
+					bestScore = triangleScore[t];
+					best = t;
+				}
+			}
+			if( best < 0 )
+				break;
+		}
+
+		const unsigned int t = static_cast<unsigned int>(best);
+		added[t] = true;
+		order.push_back(t);
+
+		// Move the triangle's vertices to the front of the cache
+		nextCache.clear();
+		for(unsigned int k = 0; k < 3; ++k)
+		{
+			const unsigned int v = indices[3*t + k];
+			nextCache.push_back(v);
+
+			// Drop the triangle from the vertex's list of remaining ones
+			unsigned int *tris = &vertexTriangles[firstTriangle[v]];
+			const unsigned int n = remaining[v];
+			for(unsigned int j = 0; j < n; ++j)
+			{
+				if( tris[j] == t )
+				{
+					tris[j] = tris[n - 1];
+					break;
+				}
+			}
+			--remaining[v];
+		}
+		for each(auto v in cache)
+		{
+			if( v != nextCache[0] && v != nextCache[1] && v != nextCache[2] )
+				nextCache.push_back(v);
+		}
+		cache.swap(nextCache);
+
+		// Rescore what's in the cache and what fell out of it, then 
+		// pick the next triangle among those that touch the cache
+		for(unsigned int i = 0; i < cache.size(); ++i)
+		{
+			const unsigned int v = cache[i];
+			cachePosition[v] = (i < cacheSize) ? static_cast<int>(i) : -1;
+			const float newScore = vertexScore(cachePosition[v], remaining[v], cacheSize);
+			const float delta = newScore - score[v];
+			score[v] = newScore;
+
+			const unsigned int *tris = &vertexTriangles[firstTriangle[v]];
+			for(unsigned int j = 0; j < remaining[v]; ++j)
+				triangleScore[tris[j]] += delta;
+		}
+
+		best = -1;
+		float bestScore = -1.f;
+		for(unsigned int i = 0; i < cache.size() && i < cacheSize; ++i)
+		{
+			const unsigned int v = cache[i];
+			const unsigned int *tris = &vertexTriangles[firstTriangle[v]];
+			for(unsigned int j = 0; j < remaining[v]; ++j)
+			{
+				if( triangleScore[tris[j]] > bestScore )
+				{
+					bestScore = triangleScore[tris[j]];
+					best = tris[j];
+				}
+			}
+		}
+
+		if( cache.size() > cacheSize )
+			cache.resize(cacheSize);
+	}
+
+	assert(order.size() == numTriangles);
+}
+
+template<typename Index>
+void vertexcache::optimizeTriangles( Index *indices
+								   , const unsigned int count
+								   , const unsigned int numVertices
+								   , const unsigned int cacheSize )
+{
+	std::vector<unsigned int> order;
+	optimizeTriangleOrder(indices, count, numVertices, order, cacheSize);
+
+	const std::vector<Index> original(indices, indices + count);
+	for(unsigned int i = 0; i < order.size(); ++i)
+	{
+		indices[3*i]   = original[3*order[i]];
+		indices[3*i+1] = original[3*order[i]+1];
+		indices[3*i+2] = original[3*order[i]+2];
+	}
+}
+
+template<typename Index>
+unsigned int vertexcache::optimizeVertexOrder( Index *indices
+											 , const unsigned int count
+											 , const unsigned int numVertices
+											 , std::vector<unsigned int>& remap )
+{
+	const unsigned int unused = ~0u;
+	remap.assign(numVertices, unused);
+
+	unsigned int next = 0;
+	for(unsigned int i = 0; i < count; ++i)
+	{
+		const unsigned int v = indices[i];
+		assert(v < numVertices);
+		if( remap[v] == unused )
+			remap[v] = next++;
+		indices[i] = static_cast<Index>(remap[v]);
+	}
+
+	const unsigned int numUsed = next;
+	for(unsigned int v = 0; v < numVertices; ++v)
+	{
+		if( remap[v] == unused )
+			remap[v] = next++;
+	}
+	return numUsed;
+}
+
+
+// Index types used by the meshes and models
+template vertexcache::Stats vertexcache::measure(const unsigned short*, const unsigned int, const unsigned int);
+template vertexcache::Stats vertexcache::measure(const unsigned int*,   const unsigned int, const unsigned int);
+template void vertexcache::optimizeTriangleOrder(const unsigned short*, const unsigned int, const unsigned int, std::vector<unsigned int>&, const unsigned int);
+template void vertexcache::optimizeTriangleOrder(const unsigned int*,   const unsigned int, const unsigned int, std::vector<unsigned int>&, const unsigned int);
+template void vertexcache::optimizeTriangles(unsigned short*, const unsigned int, const unsigned int, const unsigned int);
+template void vertexcache::optimizeTriangles(unsigned int*,   const unsigned int, const unsigned int, const unsigned int);
+template unsigned int vertexcache::optimizeVertexOrder(unsigned short*, const unsigned int, const unsigned int, std::vector<unsigned int>&);
+template unsigned int vertexcache::optimizeVertexOrder(unsigned int*,   const unsigned int, const unsigned int, std::vector<unsigned int>&);
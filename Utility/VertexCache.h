@@ -0,0 +1,71 @@
+#pragma once
+/************************************************************************/
+/* VertexCache
+/* -----------
+/* Orders indexed triangles to reuse the post-transform vertex cache
+/* and vertices for fetch locality, and measures an ordering against
+/* a simulated cache so the gain can be checked without a GPU
+/************************************************************************/
+#include <vector>
+
+
+namespace vertexcache
+{
+	// Entries in the cache that is targeted and simulated
+	const unsigned int defaultCacheSize = 32;
+
+	// Results of replaying a triangle list through a FIFO cache
+	struct Stats
+	{
+		unsigned int numTriangles;
+		unsigned int numVertices;   // distinct vertices referenced
+		unsigned int transforms;    // cache misses
+		float acmr;                 // transforms per triangle, 3 at worst
+		float atvr;                 // transforms per vertex, 1 at best
+	};
+
+	/**
+	 * Simulate a FIFO post-transform cache over a triangle list
+	 * \param indices   - count indices, three per triangle
+	 * \param cacheSize - number of cache entries
+	**/
+	template<typename Index>
+	Stats measure( const Index *indices
+				 , const unsigned int count
+				 , const unsigned int cacheSize = defaultCacheSize );
+
+	/**
+	 * Pick a triangle order that keeps vertices in the cache, greedily
+	 * taking the best scored triangle after Forsyth's linear-speed 
+	 * vertex cache optimisation
+	 * \param indices     - count indices, three per triangle
+	 * \param numVertices - one more than the largest index
+	 * \param order       - receives the triangles in their new order
+	**/
+	template<typename Index>
+	void optimizeTriangleOrder( const Index *indices
+							  , const unsigned int count
+							  , const unsigned int numVertices
+							  , std::vector<unsigned int>& order
+							  , const unsigned int cacheSize = defaultCacheSize );
+
+	// Reorder the triangles of a triangle list in place
+	template<typename Index>
+	void optimizeTriangles( Index *indices
+						  , const unsigned int count
+						  , const unsigned int numVertices
+						  , const unsigned int cacheSize = defaultCacheSize );
+
+	/**
+	 * Number vertices in the order the triangles first use them,
+	 * rewriting the indices to match
+	 * \param remap - receives the new number of each old vertex, 
+	 *                unused vertices are numbered after all used ones
+	 * \return - the number of vertices the triangles use
+	**/
+	template<typename Index>
+	unsigned int optimizeVertexOrder( Index *indices
+									, const unsigned int count
+									, const unsigned int numVertices
+									, std::vector<unsigned int>& remap );
+};